@@ -28,18 +28,27 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <random>
+#include <vector>
 
 #include <CL/sycl.hpp>
 namespace sycl = cl::sycl;
 
-#include <double_buf.hpp>
+#include <ring_buf.hpp>
 
 enum class CellState : cl::sycl::cl_uint {
   LIVE = 1,
   DEAD = 0,
 };
 
+/// A cell state set by a mouse click
+struct CellClick {
+  sycl::cl_uint x;
+  sycl::cl_uint y;
+  CellState state;
+};
+
 struct GameGrid {
   /// The states of cells
   sycl::buffer<CellState, 2> cells;
@@ -62,11 +71,15 @@ class GameOfLifeSim {
   size_t m_width;
   size_t m_height;
 
-  /// Double-buffers the game grid so that we can read and write in parallel
-  DoubleBuf<GameGrid> m_game;
+  /// Ring-buffers the game grid so that we can read and write in parallel,
+  /// and display a finished frame while the next one is computed
+  RingBuf<GameGrid, 3> m_game;
 
   /// Mouse clicks on the grid recorded since last frame
-  std::vector<std::tuple<size_t, size_t, CellState>> m_clicks;
+  std::vector<CellClick> m_clicks;
+
+  /// Device copy of the clicks being applied, grown as needed
+  std::unique_ptr<sycl::buffer<CellClick, 1>> m_clicks_buf;
 
   sycl::queue m_q;
 
@@ -109,40 +122,74 @@ class GameOfLifeSim {
   /// Add a button press (cell spawn) to be processed
   void add_click(size_t x, size_t y, CellState state) {
     // Click processing is deferred until update
-    m_clicks.emplace_back(x, y, state);
+    m_clicks.push_back({static_cast<sycl::cl_uint>(x),
+                        static_cast<sycl::cl_uint>(y), state});
   }
 
   void step();
 
-  /// Calls the provided function with image data
+  /// Calls the provided function with image data of the newest completed
+  /// frame. Returns false without calling it when no frame has completed.
   template <typename Func>
-  void with_img(Func&& func) {
-    auto acc = m_game.read().img.get_access<sycl::access::mode::read>();
+  bool with_img(Func&& func) {
+    auto game = m_game.try_acquire();
+    if (!game) {
+      return false;
+    }
+    auto acc = game->img.get_access<sycl::access::mode::read>();
     func(acc.get_pointer());
+    return true;
   }
 
  private:
+  /// Uploads the recorded clicks and sets the cells they hit in a kernel, so
+  /// the host does not wait for the frames in flight
+  void apply_clicks() {
+    using sycl::access::mode;
+
+    size_t n_clicks = m_clicks.size();
+    if (!m_clicks_buf || m_clicks_buf->get_count() < n_clicks) {
+      m_clicks_buf.reset(
+          new sycl::buffer<CellClick, 1>(sycl::range<1>(n_clicks)));
+    }
+
+    // The runtime keeps the clicks alive until the copy has completed
+    auto clicks = std::make_shared<std::vector<CellClick>>();
+    clicks->swap(m_clicks);
+    std::shared_ptr<CellClick> src(clicks, clicks->data());
+
+    this->m_q.submit([&](sycl::handler& cgh) {
+      auto dst = m_clicks_buf->get_access<mode::discard_write>(
+          cgh, sycl::range<1>(n_clicks));
+      cgh.copy(src, dst);
+    });
+
+    this->m_q.submit([&](sycl::handler& cgh) {
+      auto acc = m_clicks_buf->get_access<mode::read>(
+          cgh, sycl::range<1>(n_clicks));
+      // Have to write into read-buffer rather than write-buffer, since it is
+      // the read-buffer that will be read by the kernel.
+      auto cells = this->m_game.read().cells.get_access<mode::write>(cgh);
+
+      cgh.parallel_for<class gameoflifeclickkernel>(
+          sycl::range<1>(n_clicks), [=](sycl::item<1> item) {
+            CellClick click = acc[item.get_linear_id()];
+            cells[sycl::id<2>(click.x, click.y)] = click.state;
+          });
+    });
+  }
+
   /// Executes an update frame
   void internal_step() {
     using sycl::access::mode;
     using sycl::access::target;
 
-    // Read mouse clicks since last frame and apply them to the game.
-    {
-      // Have to write into read-buffer rather than write-buffer, since it is
-      // the read-buffer
-      // that will be read by the kernel.
-      auto acc = this->m_game.read().cells.get_access<mode::write>();
-
-      while (!m_clicks.empty()) {
-        auto press = m_clicks.back();
-        m_clicks.pop_back();
-        acc[sycl::id<2>(std::get<0>(press), std::get<1>(press))] =
-            std::get<2>(press);
-      }
+    // Apply mouse clicks since last frame to the game.
+    if (!m_clicks.empty()) {
+      apply_clicks();
     }
 
-    this->m_q.submit([&](sycl::handler& cgh) {
+    auto ev = this->m_q.submit([&](sycl::handler& cgh) {
       auto r = this->m_game.read().cells.get_access<mode::read>(cgh);
       auto rv = this->m_game.read().vels.get_access<mode::read>(cgh);
       auto w = this->m_game.write().cells.get_access<mode::discard_write>(cgh);
@@ -234,7 +281,7 @@ class GameOfLifeSim {
           });
     });
 
-    // Swap read-buffer with write-buffer
-    this->m_game.swap();
+    // Make the frame being written the read-buffer
+    this->m_game.advance(ev);
   }
 };
@@ -0,0 +1,136 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2017 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  chunked_stream.hpp
+ *
+ *  Description:
+ *    Streams host-resident arrays through SyclBufs in fixed-size chunks.
+ *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <tuple>
+
+#include <CL/sycl.hpp>
+
+#include "ring_buf.hpp"
+#include "sycl_bufs.hpp"
+
+// Whether any of the buffers In is also one of the buffers Out
+template <size_t... In, size_t... Out>
+constexpr bool bufs_overlap(read_bufs_t<In...>, write_bufs_t<Out...>) {
+  const size_t ins[] = {In..., size_t(-1)};
+  const size_t outs[] = {Out..., size_t(-2)};
+  for (size_t i = 0; i < sizeof...(In); i++) {
+    for (size_t o = 0; o < sizeof...(Out); o++) {
+      if (ins[i] == outs[o]) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Processes arrays of elements of the types Ts that live in host memory and
+// may be larger than the device memory. The arrays are uploaded a chunk at a
+// time into one of two sets of device buffers, so that the upload of a chunk
+// overlaps the kernel working on the previous one, and the results of each
+// chunk are copied back to the host as soon as its kernel has finished.
+template <typename... Ts>
+class ChunkedStream {
+  cl::sycl::queue& m_q;
+
+  // The number of elements in a chunk
+  size_t m_chunk;
+
+  // Two sets of chunk buffers: one is uploaded while the other is computed
+  RingBuf<SyclBufs<Ts...>, 2> m_bufs;
+
+ public:
+  ChunkedStream(cl::sycl::queue& q, size_t chunk)
+      : m_q(q), m_chunk(chunk), m_bufs(chunk) {}
+
+  size_t chunk_size() const { return m_chunk; }
+
+  // Runs func on every chunk of the n elements of the host arrays. The arrays
+  // selected by In are uploaded before func is called and those selected by
+  // Out are copied back after it. func is called as
+  //   func(cgh, read_accs, write_accs, count, offset)
+  // with the accessors of SyclBufs::gen_read_accs and gen_write_accs for the
+  // chunk buffers, the number of elements in the chunk and the index of its
+  // first element in the host arrays. It must submit a kernel that reads and
+  // writes the first count elements of the accessors. Returns once every
+  // result has been written back. An array cannot be both In and Out, since
+  // the write accessors discard the chunk that was uploaded.
+  template <size_t... In, size_t... Out, typename Func>
+  void run(std::tuple<Ts*...> host, size_t n, read_bufs_t<In...>,
+           write_bufs_t<Out...>, Func&& func) {
+    static_assert(!bufs_overlap(read_bufs_t<In...>{}, write_bufs_t<Out...>{}),
+                  "An array cannot be both read and written: stream it into "
+                  "one array and out of another");
+    for (size_t offset = 0; offset < n; offset += m_chunk) {
+      size_t count = std::min(m_chunk, n - offset);
+      auto& bufs = m_bufs.write();
+
+      int uploads[] = {
+          0, (upload(bufs.template get_buffer<In>(),
+                     std::get<In>(host) + offset, count),
+              0)...};
+      (void)uploads;
+
+      auto ev = m_q.submit([&](cl::sycl::handler& cgh) {
+        func(cgh, bufs.gen_read_accs(cgh, read_bufs_t<In...>{}),
+             bufs.gen_write_accs(cgh, write_bufs_t<Out...>{}), count, offset);
+      });
+
+      int downloads[] = {
+          0, (download(bufs.template get_buffer<Out>(),
+                       std::get<Out>(host) + offset, count),
+              0)...};
+      (void)downloads;
+
+      m_bufs.advance(ev);
+    }
+    m_q.wait_and_throw();
+  }
+
+ private:
+  // Copies count elements from the host into the start of buf
+  template <typename T>
+  void upload(cl::sycl::buffer<T, 1>& buf, T const* src, size_t count) {
+    m_q.submit([&](cl::sycl::handler& cgh) {
+      auto acc = buf.template get_access<cl::sycl::access::mode::discard_write>(
+          cgh, cl::sycl::range<1>(count));
+      cgh.copy(src, acc);
+    });
+  }
+
+  // Copies count elements from the start of buf to the host
+  template <typename T>
+  void download(cl::sycl::buffer<T, 1>& buf, T* dst, size_t count) {
+    m_q.submit([&](cl::sycl::handler& cgh) {
+      auto acc = buf.template get_access<cl::sycl::access::mode::read>(
+          cgh, cl::sycl::range<1>(count));
+      cgh.copy(acc, dst);
+    });
+  }
+};
@@ -0,0 +1,144 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2017 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  device_vector.hpp
+ *
+ *  Description:
+ *    A growable array of values stored in a SYCL buffer.
+ *
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+
+#include <CL/sycl.hpp>
+
+// Growable array of values of type T in device memory. The buffer holds
+// capacity() elements of which the first size() are in use. Growing within
+// the capacity does not allocate, and growing past it at least doubles the
+// capacity and copies the elements on the device.
+template <typename T>
+class device_vector {
+  cl::sycl::queue& m_q;
+
+  // The number of elements in use
+  size_t m_size;
+
+  // The number of elements the buffer holds. At least 1, since buffers
+  // cannot be empty.
+  size_t m_capacity;
+
+  cl::sycl::buffer<T, 1> m_buf;
+
+ public:
+  device_vector(cl::sycl::queue& q, size_t n = 0)
+      : m_q(q),
+        m_size(0),
+        m_capacity(std::max<size_t>(n, 1)),
+        m_buf(cl::sycl::range<1>(m_capacity)) {
+    resize(n);
+  }
+
+  size_t size() const { return m_size; }
+
+  size_t capacity() const { return m_capacity; }
+
+  bool empty() const { return m_size == 0; }
+
+  // The buffer holding the elements. It is replaced when the vector
+  // reallocates, so it must be requested again after growing.
+  cl::sycl::buffer<T, 1>& get_buffer() { return m_buf; }
+
+  // Accessor to the elements in use. Accessors cannot have an empty range,
+  // so for an empty vector it covers the first, unused, element.
+  template <cl::sycl::access::mode Mode>
+  cl::sycl::accessor<T, 1, Mode> get_access(cl::sycl::handler& cgh) {
+    return m_buf.template get_access<Mode>(
+        cgh, cl::sycl::range<1>(std::max<size_t>(m_size, 1)));
+  }
+
+  // Makes room for n elements without changing the size
+  void reserve(size_t n) {
+    if (n > m_capacity) {
+      reallocate(n);
+    }
+  }
+
+  // Changes the number of elements, setting new ones to value
+  void resize(size_t n, T const& value = T()) {
+    grow_to(n);
+    if (n > m_size) {
+      size_t old_size = m_size;
+      m_q.submit([&](cl::sycl::handler& cgh) {
+        auto acc = m_buf.template get_access<
+            cl::sycl::access::mode::discard_write>(
+            cgh, cl::sycl::range<1>(n - old_size), cl::sycl::id<1>(old_size));
+        cgh.fill(acc, value);
+      });
+    }
+    m_size = n;
+  }
+
+  // Appends count elements copied from the host. data must stay valid until
+  // the queue has finished the copy.
+  void push_back_bulk(T const* data, size_t count) {
+    if (count == 0) {
+      return;
+    }
+    grow_to(m_size + count);
+    size_t old_size = m_size;
+    m_q.submit([&](cl::sycl::handler& cgh) {
+      auto acc =
+          m_buf.template get_access<cl::sycl::access::mode::discard_write>(
+              cgh, cl::sycl::range<1>(count), cl::sycl::id<1>(old_size));
+      cgh.copy(data, acc);
+    });
+    m_size += count;
+  }
+
+  // Removes all elements, keeping the capacity
+  void clear() { m_size = 0; }
+
+ private:
+  // Ensures the capacity for n elements, growing geometrically
+  void grow_to(size_t n) {
+    if (n > m_capacity) {
+      reallocate(std::max(n, 2 * m_capacity));
+    }
+  }
+
+  // Moves the elements in use into a new buffer of the given capacity
+  void reallocate(size_t capacity) {
+    cl::sycl::buffer<T, 1> buf{cl::sycl::range<1>(capacity)};
+    if (m_size > 0) {
+      m_q.submit([&](cl::sycl::handler& cgh) {
+        auto src = m_buf.template get_access<cl::sycl::access::mode::read>(
+            cgh, cl::sycl::range<1>(m_size));
+        auto dst =
+            buf.template get_access<cl::sycl::access::mode::discard_write>(
+                cgh, cl::sycl::range<1>(m_size));
+        cgh.copy(src, dst);
+      });
+    }
+    m_buf = buf;
+    m_capacity = capacity;
+  }
+};
@@ -27,6 +27,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
 #include "tuple_utils.hpp"
 
 /* Given a function `func` expressing a derivative of order N, a time step size
@@ -109,3 +113,297 @@ std::tuple<Args...> integrate_step_euler(func_t func, time_t step, Args... vals
                      squash_tuple<0, 2>(init), std::make_tuple(time_t(1)));
   return add_tuples(init, mult_tuple(to_add, step));
 }
+
+/* Given a function `func` expressing the second derivative a = f(v, x, t) of
+ * a position x, a time step size `step`, the acceleration `acc` at the start
+ * of the step and the initial velocity `vel`, position `pos` and time `t`,
+ * returns the new acceleration, velocity, position and time after the step in
+ * a tuple. Uses velocity Verlet integration, which is symplectic when the
+ * acceleration only depends on the position. The returned acceleration is
+ * passed to the next step, so every step evaluates `func` once. */
+template <typename time_t, typename func_t, typename acc_t, typename vel_t,
+          typename pos_t, typename t_t>
+std::tuple<acc_t, vel_t, pos_t, t_t> integrate_step_verlet(func_t func,
+                                                           time_t step,
+                                                           acc_t acc,
+                                                           vel_t vel,
+                                                           pos_t pos, t_t t) {
+  auto const new_pos = pos + vel * step + acc * (step * step / time_t(2));
+  auto const new_t = t + step;
+  // The velocity at the end of the step is not known yet, so the function is
+  // given an Euler estimate of it
+  auto const new_acc = func(vel + acc * step, new_pos, new_t);
+  auto const new_vel = vel + (acc + new_acc) * (step / time_t(2));
+  return std::make_tuple(new_acc, new_vel, new_pos, new_t);
+}
+
+/* Given a function `func` expressing the second derivative a = f(v, x, t) of
+ * a position x, a time step size `step`, and the initial velocity `vel`,
+ * position `pos` and time `t`, returns the new velocity, position and time
+ * after the step in a tuple. Uses kick-drift-kick leapfrog integration with
+ * the closing half kick of a step merged into the opening half kick of the
+ * next, so `vel` and the returned velocity are half a step behind the
+ * position. Evaluates `func` once per step and is symplectic when the
+ * acceleration only depends on the position. */
+template <typename time_t, typename func_t, typename vel_t, typename pos_t,
+          typename t_t>
+std::tuple<vel_t, pos_t, t_t> integrate_step_leapfrog(func_t func, time_t step,
+                                                     vel_t vel, pos_t pos,
+                                                     t_t t) {
+  // kick
+  auto const new_vel = vel + func(vel, pos, t) * step;
+  // drift
+  auto const new_pos = pos + new_vel * step;
+  return std::make_tuple(new_vel, new_pos, t + step);
+}
+
+/* Butcher tableaus of explicit Runge-Kutta methods for integrate_step_rk.
+ * `a(i, j)` gives the stage coefficients below the diagonal, `b(j)` the
+ * weights of the solution and `b_hat(j)` those of the embedded solution of
+ * order `embedded_order` used to estimate the error. Methods without an
+ * embedded solution repeat `b`. The nodes are not needed, since time is
+ * integrated along with the other values. The coefficients are returned by
+ * constexpr functions rather than stored in static arrays, which would need
+ * out-of-line definitions before C++17 to be read at runtime. */
+
+// Heun's method with an embedded Euler solution
+struct tableau_rk2 {
+  static constexpr size_t stages = 2;
+  static constexpr int order = 2;
+  static constexpr int embedded_order = 1;
+  static constexpr double a(size_t i, size_t j) {
+    constexpr double c[stages][stages] = {{0, 0}, {1, 0}};
+    return c[i][j];
+  }
+  static constexpr double b(size_t j) {
+    constexpr double c[stages] = {1. / 2, 1. / 2};
+    return c[j];
+  }
+  static constexpr double b_hat(size_t j) {
+    constexpr double c[stages] = {1, 0};
+    return c[j];
+  }
+};
+
+// Bogacki-Shampine method with an embedded second order solution
+struct tableau_rk3 {
+  static constexpr size_t stages = 4;
+  static constexpr int order = 3;
+  static constexpr int embedded_order = 2;
+  static constexpr double a(size_t i, size_t j) {
+    constexpr double c[stages][stages] = {{0, 0, 0, 0},
+                                          {1. / 2, 0, 0, 0},
+                                          {0, 3. / 4, 0, 0},
+                                          {2. / 9, 1. / 3, 4. / 9, 0}};
+    return c[i][j];
+  }
+  static constexpr double b(size_t j) {
+    constexpr double c[stages] = {2. / 9, 1. / 3, 4. / 9, 0};
+    return c[j];
+  }
+  static constexpr double b_hat(size_t j) {
+    constexpr double c[stages] = {7. / 24, 1. / 4, 1. / 3, 1. / 8};
+    return c[j];
+  }
+};
+
+// The classic fourth order method, without an error estimate
+struct tableau_rk4 {
+  static constexpr size_t stages = 4;
+  static constexpr int order = 4;
+  static constexpr int embedded_order = 4;
+  static constexpr double a(size_t i, size_t j) {
+    constexpr double c[stages][stages] = {
+        {0, 0, 0, 0}, {1. / 2, 0, 0, 0}, {0, 1. / 2, 0, 0}, {0, 0, 1, 0}};
+    return c[i][j];
+  }
+  static constexpr double b(size_t j) {
+    constexpr double c[stages] = {1. / 6, 1. / 3, 1. / 3, 1. / 6};
+    return c[j];
+  }
+  static constexpr double b_hat(size_t j) { return b(j); }
+};
+
+// Dormand-Prince 5(4) method
+struct tableau_dopri5 {
+  static constexpr size_t stages = 7;
+  static constexpr int order = 5;
+  static constexpr int embedded_order = 4;
+  static constexpr double a(size_t i, size_t j) {
+    constexpr double c[stages][stages] = {
+        {0, 0, 0, 0, 0, 0, 0},
+        {1. / 5, 0, 0, 0, 0, 0, 0},
+        {3. / 40, 9. / 40, 0, 0, 0, 0, 0},
+        {44. / 45, -56. / 15, 32. / 9, 0, 0, 0, 0},
+        {19372. / 6561, -25360. / 2187, 64448. / 6561, -212. / 729, 0, 0, 0},
+        {9017. / 3168, -355. / 33, 46732. / 5247, 49. / 176, -5103. / 18656,
+         0, 0},
+        {35. / 384, 0, 500. / 1113, 125. / 192, -2187. / 6784, 11. / 84, 0}};
+    return c[i][j];
+  }
+  // The last stage is evaluated at the solution
+  static constexpr double b(size_t j) { return a(stages - 1, j); }
+  static constexpr double b_hat(size_t j) {
+    constexpr double c[stages] = {5179. / 57600,    0,
+                                  7571. / 16695,    393. / 640,
+                                  -92097. / 339200, 187. / 2100,
+                                  1. / 40};
+    return c[j];
+  }
+};
+
+// Stages of the generic Runge-Kutta engine, unrolled at compile time
+namespace {
+/* The derivatives of the values in `args`: yN, .., y1, 1.0 */
+template <typename time_t, typename func_t, typename state_t>
+state_t rk_derivative(func_t& func, state_t const& args) {
+  return std::tuple_cat(std::make_tuple(call(func, args)),
+                        squash_tuple<0, 2>(args), std::make_tuple(time_t(1)));
+}
+
+/* Weights of the combinations of stage derivatives, as constant expressions:
+ * the coefficients of stage `I`, the weights of the solution and those of the
+ * embedded solution */
+template <typename tableau_t, size_t I>
+struct rk_stage_weights {
+  static constexpr double weight(size_t j) { return tableau_t::a(I, j); }
+};
+
+template <typename tableau_t>
+struct rk_solution_weights {
+  static constexpr double weight(size_t j) { return tableau_t::b(j); }
+};
+
+template <typename tableau_t>
+struct rk_embedded_weights {
+  static constexpr double weight(size_t j) { return tableau_t::b_hat(j); }
+};
+
+/* Adds `step` times `w` times the stage derivative `k` to `sum`, or nothing
+ * when the weight is zero */
+template <typename time_t, typename state_t>
+void rk_add(state_t&, state_t const&, time_t, double, std::false_type) {}
+
+template <typename time_t, typename state_t>
+void rk_add(state_t& sum, state_t const& k, time_t step, double w,
+            std::true_type) {
+  sum = add_tuples(sum, mult_tuple(k, step * time_t(w)));
+}
+
+/* Adds `step` times the combination of the stage derivatives `ks` with the
+ * weights of `weights_t` to `init`. Terms with a zero weight are not
+ * instantiated. */
+template <typename weights_t, typename time_t, typename state_t, size_t N,
+          size_t... Js>
+state_t rk_combine(state_t const& init, state_t const (&ks)[N], time_t step,
+                   index_sequence<Js...>) {
+  state_t sum = init;
+  int unused[] = {
+      0, (rk_add(sum, ks[Js], step, weights_t::weight(Js),
+                 std::integral_constant<bool, weights_t::weight(Js) != 0>{}),
+          0)...};
+  (void)unused;
+  // The first stage combines no derivatives
+  (void)step;
+  return sum;
+}
+
+/* Evaluates the derivatives of every stage in order */
+template <typename tableau_t, typename time_t, typename func_t,
+          typename state_t, size_t... Is>
+void rk_stages(func_t& func, time_t step, state_t const& init,
+               state_t (&ks)[tableau_t::stages], index_sequence<Is...>) {
+  int unused[] = {
+      0, (ks[Is] = rk_derivative<time_t>(
+              func, rk_combine<rk_stage_weights<tableau_t, Is>>(
+                        init, ks, step, make_index_sequence<Is>{})),
+          0)...};
+  (void)unused;
+}
+}  // namespace
+
+/* Given a function `func` expressing a derivative of order N, a time step size
+ * `step`, and N+1 values `vals` with the initial conditions of y(N-1), .., y1,
+ * y, t, in that order, returns the new values of y(N-1), ..., y1, y, t after
+ * the step in a tuple, and stores the estimate of their local error in
+ * `error`. Uses the explicit Runge-Kutta method with the Butcher tableau
+ * `tableau_t`. */
+template <typename tableau_t, typename time_t, typename func_t,
+          typename... Args>
+std::tuple<Args...> integrate_step_rk(func_t func, time_t step,
+                                      std::tuple<Args...>& error,
+                                      Args... vals) {
+  static_assert(sizeof...(Args) >= 2,
+                "Do you want infinite loops in your compiler? Because this is "
+                "how you get infinite loops in your compiler.");
+  using state_t = std::tuple<Args...>;
+  constexpr size_t stages = tableau_t::stages;
+
+  state_t const init = std::make_tuple(vals...);
+  state_t ks[stages];
+  rk_stages<tableau_t>(func, step, init, ks, make_index_sequence<stages>{});
+
+  auto const all = make_index_sequence<stages>{};
+  state_t const result =
+      rk_combine<rk_solution_weights<tableau_t>>(init, ks, step, all);
+  // The difference between the solution and the embedded one
+  error = add_tuples(
+      result, mult_tuple(rk_combine<rk_embedded_weights<tableau_t>>(init, ks,
+                                                                    step, all),
+                         time_t(-1)));
+  return result;
+}
+
+/* As above, without the error estimate. */
+template <typename tableau_t, typename time_t, typename func_t,
+          typename... Args>
+std::tuple<Args...> integrate_step_rk(func_t func, time_t step,
+                                      Args... vals) {
+  std::tuple<Args...> error;
+  return integrate_step_rk<tableau_t>(func, step, error, vals...);
+}
+
+/* Given a function `func` expressing a derivative of order N, a time step size
+ * `step`, a tolerance `tol`, a function `norm` mapping a tuple of errors of
+ * y(N-1), .., y1, y, t to a scalar, and N+1 values `vals` with the initial
+ * conditions of y(N-1), .., y1, y, t, in that order, returns the new values
+ * of y(N-1), ..., y1, y, t after a step whose estimated error is at most
+ * `tol`. Steps are retried with a smaller size until the error is small
+ * enough, or `max_tries` steps have been taken. `accepted` is set to whether
+ * the returned step meets the tolerance: when it is false, the values are
+ * those of the last, rejected, try and the caller should retry from `vals`
+ * or stop. `step` is set to the size suggested for the next step.
+ * `tableau_t` must have an embedded solution. */
+template <typename tableau_t, typename time_t, typename func_t,
+          typename norm_t, typename... Args>
+std::tuple<Args...> integrate_step_adaptive(func_t func, time_t& step,
+                                            time_t tol, norm_t norm,
+                                            bool& accepted, Args... vals) {
+  static_assert(tableau_t::embedded_order < tableau_t::order,
+                "Adaptive steps need a tableau with an embedded solution");
+  constexpr int max_tries = 8;
+  // Bounds on the change of the step size from one step to the next
+  constexpr time_t min_scale = time_t(0.2);
+  constexpr time_t max_scale = time_t(5);
+  constexpr time_t safety = time_t(0.9);
+
+  std::tuple<Args...> result;
+  accepted = false;
+  for (int i = 0; i < max_tries; i++) {
+    std::tuple<Args...> error;
+    result = integrate_step_rk<tableau_t>(func, step, error, vals...);
+    time_t const err = norm(error);
+    time_t scale =
+        err == time_t(0)
+            ? max_scale
+            : safety * std::pow(tol / err,
+                                time_t(1) / (tableau_t::embedded_order + 1));
+    scale = std::min(max_scale, std::max(min_scale, scale));
+    accepted = err <= tol;
+    step *= scale;
+    if (accepted) {
+      break;
+    }
+  }
+  return result;
+}
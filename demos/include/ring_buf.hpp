@@ -0,0 +1,104 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2017 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  ring_buf.hpp
+ *
+ *  Description:
+ *    Provides an N-way ring buffer class that tracks the event producing
+ *    each of its slots.
+ *
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <CL/sycl.hpp>
+
+// Ring-buffers N copies of any kind of value. Each step reads the newest
+// slot and writes the one after it, so the host can read a finished frame
+// while the following N - 2 frames are still being computed.
+template <typename T, size_t N>
+class RingBuf {
+  static_assert(N >= 2, "A ring buffer needs at least two slots");
+
+ public:
+  template <typename... U>
+  RingBuf(U&&... vals) : m_read(0), m_events(N) {
+    m_slots.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+      m_slots.emplace_back(vals...);
+    }
+  }
+
+  static constexpr size_t size() { return N; }
+
+  // The slot holding the newest frame, which may still be in flight
+  T& read() { return m_slots[m_read]; }
+
+  // The slot the next frame is written to. It holds the oldest frame.
+  T& write() { return m_slots[next(m_read)]; }
+
+  // Makes the write slot the read slot. ev is the event of the command group
+  // that writes it, the default event is complete for data written on the
+  // host.
+  void advance(cl::sycl::event ev = cl::sycl::event{}) {
+    m_read = next(m_read);
+    m_events[m_read] = ev;
+  }
+
+  // Returns the newest slot whose frame is complete, or nullptr when all of
+  // them are still in flight. Never blocks. The write slot is not returned,
+  // since the next step overwrites it.
+  T* try_acquire() {
+    size_t slot = m_read;
+    for (size_t i = 0; i + 1 < N; i++) {
+      if (is_complete(m_events[slot])) {
+        return &m_slots[slot];
+      }
+      slot = prev(slot);
+    }
+    return nullptr;
+  }
+
+  // Blocks until the newest frame is complete and returns its slot
+  T& acquire() {
+    m_events[m_read].wait();
+    return read();
+  }
+
+ private:
+  static size_t next(size_t slot) { return (slot + 1) % N; }
+
+  static size_t prev(size_t slot) { return (slot + N - 1) % N; }
+
+  static bool is_complete(const cl::sycl::event& ev) {
+    return ev.get_info<cl::sycl::info::event::command_execution_status>() ==
+           cl::sycl::info::event_command_status::complete;
+  }
+
+  // Index of the slot holding the newest frame
+  size_t m_read;
+  std::vector<T> m_slots;
+  // Event of the command group that wrote each slot
+  std::vector<cl::sycl::event> m_events;
+};
@@ -21,60 +21,227 @@
  *  sycl_bufs.hpp
  *
  *  Description:
- *    A class for storing and accessing buffers of values of any given types.
+ *    A class for storing and accessing buffers of values of any given types,
+ *    laid out in memory according to a layout policy.
  *
  **************************************************************************/
 
 #pragma once
 
+#include <tuple>
 #include <type_traits>
 
 #include <CL/sycl.hpp>
 
 #include "tuple_utils.hpp"
 
-// Template function object which transforms buffers to device read accessors
-struct BufToReadAccFunc {
-  template <typename In>
-  AUTO_FUNC(
-      // pair of (buffer, handler)
-      operator()(In&& in),
-      std::forward<In>(in)
-          .first.template get_access<cl::sycl::access::mode::read>(
-              *std::forward<In>(in).second))
+// Layout policies for SyclLayoutBufs. They only change how vector elements
+// are stored, scalar elements are always stored one after the other.
+
+// Array of structures: vectors one after the other. 3-component vectors are
+// padded to 4 components.
+struct aos_layout {};
+
+// Structure of arrays: one array for each component of the vectors, e.g.
+// all x components followed by all y components.
+struct soa_layout {};
+
+// Array of structures of arrays: tiles of W vectors, each storing the W x
+// components followed by the W y components and so on. The number of
+// vectors is rounded up to a multiple of W.
+template <size_t W>
+struct aosoa_layout {};
+
+// Reference to a vector stored as separate components. Reads load each
+// component, assignments store each component.
+template <typename View>
+class split_ref {
+  View const& m_view;
+  size_t m_i;
+
+ public:
+  using vec_t = typename View::vec_t;
+
+  split_ref(View const& view, size_t i) : m_view(view), m_i(i) {}
+
+  operator vec_t() const { return m_view.load(m_i); }
+
+  split_ref& operator=(vec_t const& v) {
+    m_view.store(m_i, v);
+    return *this;
+  }
+
+  split_ref& operator=(split_ref const& other) {
+    return *this = other.m_view.load(other.m_i);
+  }
+
+  template <typename U>
+  split_ref& operator+=(U const& u) {
+    return *this = m_view.load(m_i) + u;
+  }
+
+  template <typename U>
+  split_ref& operator-=(U const& u) {
+    return *this = m_view.load(m_i) - u;
+  }
+
+  template <typename U>
+  split_ref& operator*=(U const& u) {
+    return *this = m_view.load(m_i) * u;
+  }
 };
 
-// Template function object which transforms buffers to device write accessors
-struct BufToDcdWriteAccFunc {
-  // pair of (buffer, handler)
-  template <typename In>
-  AUTO_FUNC(operator()(In&& in),
-            std::forward<In>(in)
-                .first
-                .template get_access<cl::sycl::access::mode::discard_write>(
-                    *std::forward<In>(in).second))
+// The access mode of an accessor type
+template <typename Acc>
+struct accessor_mode;
+
+template <typename U, int d, cl::sycl::access::mode m,
+          cl::sycl::access::target t, cl::sycl::access::placeholder p>
+struct accessor_mode<cl::sycl::accessor<U, d, m, t, p>> {
+  static constexpr cl::sycl::access::mode value = m;
 };
 
-// Template function object which transforms buffers to host read accessors
-struct BufToHostReadAccFunc {
-  template <typename In>
-  auto operator()(In&& in)
-      -> decltype(std::forward<In>(in)
-                      .template get_access<cl::sycl::access::mode::read>()) {
-    return std::forward<In>(in)
-        .template get_access<cl::sycl::access::mode::read>();
+// View of vectors of K components of type T stored as separate components in
+// the memory of an accessor. W is the tile width of an AoSoA layout, or 0 for
+// an SoA layout where the tile is the whole array. Indexing a view over a
+// read accessor returns vectors, indexing a view over a write accessor
+// returns a split_ref.
+template <typename Acc, typename T, int K, size_t W>
+class split_view {
+  Acc m_acc;
+  // Number of vectors, used as the tile width of the SoA layout
+  size_t m_n;
+
+  static constexpr bool is_writable =
+      accessor_mode<Acc>::value != cl::sycl::access::mode::read;
+
+ public:
+  using vec_t = cl::sycl::vec<T, K>;
+
+  split_view(Acc acc, size_t n) : m_acc(acc), m_n(n) {}
+
+  // Offset of component c of vector i
+  size_t offset(size_t i, int c) const {
+    return W == 0 ? c * m_n + i : (i / W) * K * W + c * W + i % W;
+  }
+
+  vec_t load(size_t i) const {
+    vec_t v;
+    load_help(v, i, make_index_sequence<K>{});
+    return v;
+  }
+
+  void store(size_t i, vec_t const& v) const {
+    store_help(v, i, make_index_sequence<K>{});
+  }
+
+  // Component c of vector i
+  AUTO_FUNC(get(size_t i, int c) const, m_acc[offset(i, c)])
+
+  template <bool Writable = is_writable>
+  typename std::enable_if<!Writable, vec_t>::type operator[](size_t i) const {
+    return load(i);
+  }
+
+  template <bool Writable = is_writable>
+  typename std::enable_if<Writable, split_ref<split_view>>::type operator[](
+      size_t i) const {
+    return split_ref<split_view>(*this, i);
+  }
+
+ private:
+  template <size_t... Cs>
+  void load_help(vec_t& v, size_t i, index_sequence<Cs...>) const {
+    T comps[] = {m_acc[offset(i, Cs)]...};
+    v = vec_t(comps[Cs]...);
+  }
+
+  template <size_t... Cs>
+  void store_help(vec_t const& v, size_t i, index_sequence<Cs...>) const {
+    T comps[K];
+    v.store(0, cl::sycl::private_ptr<T>(comps));
+    int unused[] = {(m_acc[offset(i, Cs)] = comps[Cs], 0)...};
+    (void)unused;
   }
 };
 
-// Template function object which transforms buffers to host write accessors
-struct BufToHostDcdWriteAccFunc {
-  template <typename In>
-  auto operator()(In&& in) -> decltype(
-      std::forward<In>(in)
-          .template get_access<cl::sycl::access::mode::discard_write>()) {
-    return std::forward<In>(in)
-        .template get_access<cl::sycl::access::mode::discard_write>();
+// Buffer and accessors for elements of type T stored with layout Layout. The
+// generic case stores the elements one after the other and accesses them
+// through plain accessors.
+template <typename Layout, typename T>
+struct layout_storage {
+  using buffer_t = cl::sycl::buffer<T, 1>;
+
+  static buffer_t make_buffer(size_t n) { return buffer_t(n); }
+
+  template <cl::sycl::access::mode Mode>
+  static AUTO_FUNC(view(buffer_t& buf, size_t, cl::sycl::handler& cgh),
+                   buf.template get_access<Mode>(cgh))
+
+  static AUTO_FUNC(read_view(buffer_t& buf, size_t, cl::sycl::handler& cgh),
+                   buf.template get_access<cl::sycl::access::mode::read>(cgh))
+
+  static AUTO_FUNC(
+      write_view(buffer_t& buf, size_t, cl::sycl::handler& cgh),
+      buf.template get_access<cl::sycl::access::mode::discard_write>(cgh))
+
+  static AUTO_FUNC(host_read_view(buffer_t& buf, size_t),
+                   buf.template get_access<cl::sycl::access::mode::read>())
+
+  static AUTO_FUNC(
+      host_write_view(buffer_t& buf, size_t),
+      buf.template get_access<cl::sycl::access::mode::discard_write>())
+};
+
+// Vectors stored as separate components in tiles of W vectors, or in a single
+// tile for W == 0.
+template <typename T, int K, size_t W>
+struct split_storage {
+  using buffer_t = cl::sycl::buffer<T, 1>;
+
+  static size_t padded_size(size_t n) {
+    return W == 0 ? n : (n + W - 1) / W * W;
+  }
+
+  static buffer_t make_buffer(size_t n) { return buffer_t(K * padded_size(n)); }
+
+  template <typename Acc>
+  static split_view<Acc, T, K, W> make_view(Acc acc, size_t n) {
+    return split_view<Acc, T, K, W>(acc, n);
   }
+
+  template <cl::sycl::access::mode Mode>
+  static AUTO_FUNC(view(buffer_t& buf, size_t n, cl::sycl::handler& cgh),
+                   make_view(buf.template get_access<Mode>(cgh), n))
+
+  static AUTO_FUNC(
+      read_view(buffer_t& buf, size_t n, cl::sycl::handler& cgh),
+      make_view(buf.template get_access<cl::sycl::access::mode::read>(cgh), n))
+
+  static AUTO_FUNC(
+      write_view(buffer_t& buf, size_t n, cl::sycl::handler& cgh),
+      make_view(
+          buf.template get_access<cl::sycl::access::mode::discard_write>(cgh),
+          n))
+
+  static AUTO_FUNC(
+      host_read_view(buffer_t& buf, size_t n),
+      make_view(buf.template get_access<cl::sycl::access::mode::read>(), n))
+
+  static AUTO_FUNC(
+      host_write_view(buffer_t& buf, size_t n),
+      make_view(
+          buf.template get_access<cl::sycl::access::mode::discard_write>(), n))
+};
+
+template <typename T, int K>
+struct layout_storage<soa_layout, cl::sycl::vec<T, K>>
+    : split_storage<T, K, 0> {};
+
+template <size_t W, typename T, int K>
+struct layout_storage<aosoa_layout<W>, cl::sycl::vec<T, K>>
+    : split_storage<T, K, W> {
+  static_assert(W > 0, "The tile width must be positive");
 };
 
 // Which buffers to read
@@ -85,42 +252,62 @@ struct read_bufs_t {};
 template <size_t... Ids>
 struct write_bufs_t {};
 
-// Provides a buffer for elements of each of the variadic types Ts
-template <typename... Ts>
-class SyclBufs {
-  std::tuple<cl::sycl::buffer<Ts, 1>...> m_bufs;
+// Provides a buffer for elements of each of the variadic types Ts, stored
+// with the layout Layout. The accessor generators return accessors for
+// elements stored one after the other, and split_views otherwise.
+template <typename Layout, typename... Ts>
+class SyclLayoutBufs {
+  template <size_t Id>
+  using storage_t = layout_storage<
+      Layout, typename std::tuple_element<Id, std::tuple<Ts...>>::type>;
+
+  std::tuple<typename layout_storage<Layout, Ts>::buffer_t...> m_bufs;
+
+  // The number of elements in each buffer
+  size_t m_n;
 
  public:
-  SyclBufs(size_t N)
-      : m_bufs(make_tuple_multi<size_t, cl::sycl::buffer<Ts, 1>...>(N)) {}
+  SyclLayoutBufs(size_t N)
+      : m_bufs(layout_storage<Layout, Ts>::make_buffer(N)...), m_n(N) {}
+
+  size_t size() const { return m_n; }
 
-  // Returns a tuple of read accessors for the selected buffers
+  // Returns the buffer storing the elements of type number Id
+  template <size_t Id>
+  AUTO_FUNC(get_buffer(), std::get<Id>(m_bufs))
+
+  // Returns a tuple of read views for the selected buffers
   template <size_t... Ids>
-  AUTO_FUNC(
-      gen_read_accs(cl::sycl::handler& cgh, read_bufs_t<Ids...>),
-      transform_tuple(zip_tuples(std::make_tuple(std::get<Ids>(m_bufs)...),
-                                 make_homogenous_tuple<cl::sycl::handler*,
-                                                       sizeof...(Ids)>(&cgh)),
-                      BufToReadAccFunc{}))
-
-  // Returns a tuple of write accessors for the selected buffers
+  AUTO_FUNC(gen_read_accs(cl::sycl::handler& cgh, read_bufs_t<Ids...>),
+            std::make_tuple(storage_t<Ids>::read_view(std::get<Ids>(m_bufs),
+                                                      m_n, cgh)...))
+
+  // Returns a tuple of write views for the selected buffers
   template <size_t... Ids>
-  AUTO_FUNC(
-      gen_write_accs(cl::sycl::handler& cgh, write_bufs_t<Ids...>),
-      transform_tuple(zip_tuples(std::make_tuple(std::get<Ids>(m_bufs)...),
-                                 make_homogenous_tuple<cl::sycl::handler*,
-                                                       sizeof...(Ids)>(&cgh)),
-                      BufToDcdWriteAccFunc{}))
-
-  // Returns a tuple of host read accessors for the selected buffers
+  AUTO_FUNC(gen_write_accs(cl::sycl::handler& cgh, write_bufs_t<Ids...>),
+            std::make_tuple(storage_t<Ids>::write_view(std::get<Ids>(m_bufs),
+                                                       m_n, cgh)...))
+
+  // Returns a tuple of views with access mode Mode for the selected buffers,
+  // e.g. mode::write to update part of a buffer and keep the rest
+  template <cl::sycl::access::mode Mode, size_t... Ids>
+  AUTO_FUNC(gen_accs(cl::sycl::handler& cgh, write_bufs_t<Ids...>),
+            std::make_tuple(storage_t<Ids>::template view<Mode>(
+                std::get<Ids>(m_bufs), m_n, cgh)...))
+
+  // Returns a tuple of host read views for the selected buffers
   template <size_t... Ids>
   AUTO_FUNC(gen_host_read_accs(read_bufs_t<Ids...>),
-            transform_tuple(std::make_tuple(std::get<Ids>(m_bufs)...),
-                            BufToHostReadAccFunc{}))
+            std::make_tuple(storage_t<Ids>::host_read_view(
+                std::get<Ids>(m_bufs), m_n)...))
 
-  // Returns a tuple of host write accessors for the selected buffers
+  // Returns a tuple of host write views for the selected buffers
   template <size_t... Ids>
   AUTO_FUNC(gen_host_write_accs(write_bufs_t<Ids...>),
-            transform_tuple(std::make_tuple(std::get<Ids>(m_bufs)...),
-                            BufToHostDcdWriteAccFunc{}))
+            std::make_tuple(storage_t<Ids>::host_write_view(
+                std::get<Ids>(m_bufs), m_n)...))
 };
+
+// Buffers with every element stored one after the other
+template <typename... Ts>
+using SyclBufs = SyclLayoutBufs<aos_layout, Ts...>;
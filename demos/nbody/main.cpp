@@ -115,6 +115,8 @@ class NBodyApp
   enum {
     UI_INTEGRATOR_EULER = 0,
     UI_INTEGRATOR_RK4 = 1,
+    UI_INTEGRATOR_VERLET = 2,
+    UI_INTEGRATOR_LEAPFROG = 3,
   };
   int32_t m_ui_integrator_id = UI_INTEGRATOR_EULER;
 
@@ -292,6 +294,14 @@ class NBodyApp
           m_sim.set_integrator(integrator_t::RK4);
         } break;
 
+        case UI_INTEGRATOR_VERLET: {
+          m_sim.set_integrator(integrator_t::VERLET);
+        } break;
+
+        case UI_INTEGRATOR_LEAPFROG: {
+          m_sim.set_integrator(integrator_t::LEAPFROG);
+        } break;
+
         default:
           throw "unreachable";
       }
@@ -313,6 +323,14 @@ class NBodyApp
                          .count();
 
         std::cout << "Time taken for step: " << sdiff << "s" << std::endl;
+
+        // Measure the force kernels alone, to compare tile sizes and devices
+        auto stats = m_sim.last_step_force_stats();
+        if (stats.second > 0) {
+          std::cout << "Force kernels: " << stats.second << "s, "
+                    << double(stats.first) / stats.second
+                    << " interactions/s" << std::endl;
+        }
       } else {
         for (int32_t step = 0; step < m_num_updates_per_frame; ++step) {
           m_sim.step();
@@ -339,18 +357,15 @@ class NBodyApp
     // Set transform to the camera view
     ci::gl::setMatrices(m_cam);
 
-    // Update star buffer data with new positions
-    m_sim.with_mapped(
-        read_bufs_t<1>{}, [&](sycl::vec<num_t, 3> const* positions) {
-          m_vbo->bufferSubData(0, m_n_bodies * sizeof(sycl::vec<num_t, 3>),
-                               positions);
-        });
-    m_sim.with_mapped(
-        read_bufs_t<0>{}, [&](sycl::vec<num_t, 3> const* velocities) {
-          m_vbo->bufferSubData(m_n_bodies * sizeof(sycl::vec<num_t, 3>),
-                               m_n_bodies * sizeof(sycl::vec<num_t, 3>),
-                               velocities);
-        });
+    // Update star buffer data with the positions and velocities of the same
+    // step, or keep the previous data when no new step has completed
+    m_sim.with_mapped(read_bufs_t<0, 1>{},
+                      [&](sycl::vec<num_t, 3> const* velocities,
+                          sycl::vec<num_t, 3> const* positions) {
+                        size_t size = m_n_bodies * sizeof(sycl::vec<num_t, 3>);
+                        m_vbo->bufferSubData(0, size, positions);
+                        m_vbo->bufferSubData(size, size, velocities);
+                      });
 
     // Enable setting point size in shader
     ci::gl::enable(GL_VERTEX_PROGRAM_POINT_SIZE, true);
@@ -378,8 +393,10 @@ class NBodyApp
     ImGui::ListBox("Type of force", &m_ui_force_id, forces.data(),
                    forces.size(), forces.size());
 
-    std::array<const char*, 2> integrators = {
-        {"Euler [fast, inaccurate]", "RK4 [slow, accurate]"}};
+    std::array<const char*, 4> integrators = {
+        {"Euler [fast, inaccurate]", "RK4 [slow, accurate]",
+         "Velocity Verlet [fast, energy-conserving]",
+         "Leapfrog [fast, energy-conserving]"}};
     ImGui::ListBox("Integrator", &m_ui_integrator_id, integrators.data(),
                    integrators.size(), integrators.size());
 
@@ -27,16 +27,22 @@
 
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <random>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 
 #include <CL/sycl.hpp>
 namespace sycl = cl::sycl;
 
 #include <integrator.hpp>
 
-#include <double_buf.hpp>
+#include <ring_buf.hpp>
 #include <sycl_bufs.hpp>
 #include <tuple_utils.hpp>
 
@@ -94,14 +100,203 @@ enum class force_t {
 enum class integrator_t {
   EULER,
   RK4,
+  VERLET,
+  LEAPFROG,
 };
 
+// Advances the velocity and position of a body by one step of the chosen
+// integrator. Velocity Verlet needs the forces at the new positions of every
+// body, so it only runs as separate kernels, see GravSim::verlet_step.
+template <typename num_t, typename func_t>
+void integrate_body(integrator_t integrator, func_t const& force, num_t step,
+                    num_t t, vec3<num_t>& vel, vec3<num_t>& pos) {
+  switch (integrator) {
+    case integrator_t::EULER:
+      std::tie(vel, pos, std::ignore) =
+          integrate_step_euler(force, step, vel, pos, t);
+      break;
+    case integrator_t::RK4:
+      std::tie(vel, pos, std::ignore) =
+          integrate_step_rk4(force, step, vel, pos, t);
+      break;
+    case integrator_t::VERLET:
+      break;
+    case integrator_t::LEAPFROG:
+      std::tie(vel, pos, std::ignore) =
+          integrate_step_leapfrog(force, step, vel, pos, t);
+      break;
+  }
+}
+
+// Position of a body in xyz and its charge in w, as stored in the tiles of
+// bodies loaded into local memory
+template <typename num_t>
+using body4 = sycl::vec<num_t, 4>;
+
+// Local memory accessor for a tile of bodies
+template <typename num_t>
+using tile_acc_t =
+    sycl::accessor<body4<num_t>, 1, sycl::access::mode::read_write,
+                   sycl::access::target::local>;
+
+// Chooses the number of bodies in a tile of the kernel kernel_name_t: the
+// largest power of two that fits both in a work-group of the kernel and in the
+// local memory of the device. A kernel using many registers may not run with
+// the maximum work-group size of the device, so the limit of the built kernel
+// is used where there is one.
+template <typename num_t, typename kernel_name_t>
+size_t choose_tile_size(sycl::queue const& q) {
+  auto dev = q.get_device();
+  size_t max_group = dev.get_info<sycl::info::device::max_work_group_size>();
+  if (!dev.is_host()) {
+    sycl::program program(q.get_context());
+    program.build_with_kernel_type<kernel_name_t>();
+    size_t max_kernel_group =
+        program.get_kernel<kernel_name_t>()
+            .template get_work_group_info<
+                sycl::info::kernel_work_group::work_group_size>(dev);
+    max_group = std::min(max_group, max_kernel_group);
+  }
+  size_t max_bodies = dev.get_info<sycl::info::device::local_mem_size>() /
+                      sizeof(body4<num_t>);
+  size_t limit = std::min(max_group, max_bodies);
+
+  size_t tile_size = 1;
+  while (tile_size * 2 <= limit) {
+    tile_size *= 2;
+  }
+  return tile_size;
+}
+
+// Sums interaction(body, i) over every body i, where load(i) returns the
+// body4 of body i. The work-group cooperatively loads the bodies into local
+// memory a tile at a time, so every work-item in the group must make the same
+// calls, including those past the last body.
+template <typename num_t, typename load_t, typename func_t>
+vec3<num_t> tiled_sum(sycl::nd_item<1> item, tile_acc_t<num_t> const& tile,
+                      size_t n_bodies, load_t const& load,
+                      func_t const& interaction) {
+  size_t lid = item.get_local_linear_id();
+  size_t tile_size = item.get_local_range(0);
+  vec3<num_t> acc(0);
+
+  for (size_t base = 0; base < n_bodies; base += tile_size) {
+    if (base + lid < n_bodies) {
+      tile[lid] = load(base + lid);
+    }
+    item.barrier(sycl::access::fence_space::local_space);
+
+    size_t count = n_bodies - base < tile_size ? n_bodies - base : tile_size;
+    for (size_t j = 0; j < count; j++) {
+      acc += interaction(tile[j], base + j);
+    }
+    item.barrier(sycl::access::fence_space::local_space);
+  }
+
+  return acc;
+}
+
+// Distance vector from x to a body
+template <typename num_t>
+vec3<num_t> body_diff(body4<num_t> const& body, vec3<num_t> const& x) {
+  return vec3<num_t>(body.x() - x.x(), body.y() - x.y(), body.z() - x.z());
+}
+
+// Computes the gravitational acceleration on body id at x from the bodies at
+// pos using the chosen constants
+template <typename num_t, typename pos_t>
+vec3<num_t> grav_accel(sycl::nd_item<1> item, tile_acc_t<num_t> const& tile,
+                       pos_t const& pos, size_t n_bodies, size_t id,
+                       vec3<num_t> x, num_t G, num_t damping) {
+  const auto load = [&](size_t i) {
+    vec3<num_t> p = pos[i];
+    return body4<num_t>(p.x(), p.y(), p.z(), num_t(0));
+  };
+
+  return G * tiled_sum(item, tile, n_bodies, load,
+                       [&](body4<num_t> const& body, size_t i) {
+                         auto const diff = body_diff(body, x);
+                         auto const r = sycl::sqrt(diff.x() * diff.x() +
+                                                   diff.y() * diff.y() +
+                                                   diff.z() * diff.z());
+                         return diff / (r * r * r +
+                                        num_t(1e24) * num_t(i == id) + damping);
+                       });
+}
+
+// Computes the acceleration on body id at x from the sum of Lennard-Jones
+// potentials between itself and the bodies at pos, scaled by A
+template <typename num_t, typename pos_t>
+vec3<num_t> lj_accel(sycl::nd_item<1> item, tile_acc_t<num_t> const& tile,
+                     pos_t const& pos, size_t n_bodies, size_t id,
+                     vec3<num_t> x, num_t A) {
+  const auto load = [&](size_t i) {
+    vec3<num_t> p = pos[i];
+    return body4<num_t>(p.x(), p.y(), p.z(), num_t(0));
+  };
+
+  return A * tiled_sum(item, tile, n_bodies, load,
+                       [&](body4<num_t> const& body, size_t i) {
+                         auto const diff = body_diff(body, x);
+                         auto const r = sycl::sqrt(diff.x() * diff.x() +
+                                                   diff.y() * diff.y() +
+                                                   diff.z() * diff.z()) +
+                                        num_t(1e24) * num_t(i == id);
+
+                         return sycl::pow(r, num_t(-8)) * diff -
+                                num_t(2) * sycl::pow(r, num_t(-14)) * diff;
+                       });
+}
+
+// Computes the Coulomb acceleration on body id at x with charge my_charge from
+// the bodies at pos with the given charges
+template <typename num_t, typename pos_t, typename charges_t>
+vec3<num_t> coulomb_accel(sycl::nd_item<1> item, tile_acc_t<num_t> const& tile,
+                          pos_t const& pos, charges_t const& charges,
+                          size_t n_bodies, size_t id, vec3<num_t> x,
+                          num_t my_charge) {
+  const auto load = [&](size_t i) {
+    vec3<num_t> p = pos[i];
+    return body4<num_t>(p.x(), p.y(), p.z(), charges[i]);
+  };
+
+  return my_charge * tiled_sum(item, tile, n_bodies, load,
+                               [&](body4<num_t> const& body, size_t i) {
+                                 auto const diff = body_diff(body, x);
+                                 auto const r = sycl::sqrt(
+                                     diff.x() * diff.x() + diff.y() * diff.y() +
+                                     diff.z() * diff.z());
+                                 return body.w() * diff /
+                                        (r * r * r +
+                                         num_t(1e24) * num_t(i == id));
+                               });
+}
+
+// Weights of the stage derivatives in a Runge-Kutta combination
+template <typename num_t, size_t S>
+struct rk_weights {
+  num_t w[S];
+};
+
+// Template to generate unique kernel name types for the staged integrator
+template <typename T, typename tableau_t, size_t Z>
+class staged_kernel {};
+
+// Names of the kernels computing accelerations outside of the Runge-Kutta
+// stages, and of the velocity Verlet and leapfrog updates around them
+class newest_accel;
+class verlet_drift;
+class verlet_accel;
+class verlet_kick;
+class half_kick;
+
 template <typename num_t>
 class GravSim {
   sycl::queue m_q;
 
-  // Buffers storing body data: (velocity, position)
-  DoubleBuf<SyclBufs<vec3<num_t>, vec3<num_t>>> m_bufs;
+  // Buffers storing body data: (velocity, position, acceleration). Three
+  // slots let the host read one step while the next one is computed.
+  RingBuf<SyclBufs<vec3<num_t>, vec3<num_t>, vec3<num_t>>, 3> m_bufs;
 
   // Buffer for charges used only in Coulomb simulation
   std::unique_ptr<SyclBufs<num_t>> m_coulomb_charges_buf = nullptr;
@@ -132,13 +327,46 @@ class GravSim {
   // Which integrator to use
   integrator_t m_integrator;
 
+  // Whether the acceleration buffer of the newest step holds the
+  // accelerations at its positions
+  bool m_acc_valid;
+
+  // Whether the velocities are half a step behind the positions, as leapfrog
+  // carries them from one step to the next
+  bool m_vel_staggered;
+
+  // Number of bodies in the tiles each force kernel loads into local memory,
+  // which is also its work-group size, by kernel name
+  std::map<std::type_index, size_t> m_tile_sizes;
+
+  // Events of the force kernels of the last step
+  std::vector<cl::sycl::event> m_force_events;
+
+  // Buffers of the staged integrators: the (velocity, position) of every body
+  // at the current stage, or after the velocity Verlet drift, and the
+  // (acceleration, velocity) derivatives of every body at each stage, stage
+  // after stage. They never reach the renderer, so they use split layouts:
+  // the force kernels load the positions component by component, and the
+  // AoSoA tiles keep the components of the derivatives of neighbouring bodies
+  // together.
+  using stage_state_t =
+      SyclLayoutBufs<soa_layout, vec3<num_t>, vec3<num_t>>;
+  using stage_derivs_t =
+      SyclLayoutBufs<aosoa_layout<16>, vec3<num_t>, vec3<num_t>>;
+  std::unique_ptr<stage_state_t> m_stage_state = nullptr;
+  std::unique_ptr<stage_derivs_t> m_stage_derivs = nullptr;
+
   // Base constructor, does not initialize simulation values
   GravSim(size_t n_bodies) :
-        m_q(sycl::default_selector{}, except_handler),
+        m_q(sycl::default_selector{}, except_handler,
+            {sycl::property::queue::enable_profiling()}),
         m_bufs(n_bodies),
         m_n_bodies(n_bodies),
         m_time(0),
-        m_force(force_t::GRAVITY) {}
+        m_force(force_t::GRAVITY),
+        m_integrator(integrator_t::EULER),
+        m_acc_valid(false),
+        m_vel_staggered(false) {}
 
  public:
   // Initialize the simulation with a cylinder body distribution
@@ -170,7 +398,7 @@ class GravSim {
     }
 
     // Make newly-written data the read-buffer
-    m_bufs.swap();
+    m_bufs.advance();
   }
 
   // Initialize the simulation with a sphere body distribution
@@ -201,7 +429,7 @@ class GravSim {
     }
 
     // Make newly-written data the read-buffer
-    m_bufs.swap();
+    m_bufs.advance();
   }
 
   GravSim(size_t n_bodies, std::vector<particle_data<num_t>>&& particles)
@@ -221,39 +449,142 @@ class GravSim {
     }
 
     // Make newly-written data the read-buffer
-    m_bufs.swap();
+    m_bufs.advance();
   }
 
   void step();
 
   void sync_queue() { m_q.wait(); }
 
-  void set_force_type(force_t force) { m_force = force; }
+  // The number of interactions between bodies the force kernels of the last
+  // step computed, and the device time they took in seconds. Waits for the
+  // kernels to complete.
+  std::pair<size_t, double> last_step_force_stats() {
+    double seconds = 0;
+    for (auto& ev : m_force_events) {
+      ev.wait();
+      auto start = ev.get_profiling_info<
+          sycl::info::event_profiling::command_start>();
+      auto end =
+          ev.get_profiling_info<sycl::info::event_profiling::command_end>();
+      seconds += double(end - start) * 1e-9;
+    }
+    return std::make_pair(m_force_events.size() * m_n_bodies * m_n_bodies,
+                          seconds);
+  }
+
+  // Every setter of the force invalidates the accelerations of the newest
+  // step, which were computed with the old one
+  void set_force_type(force_t force) {
+    m_force = force;
+    m_acc_valid = false;
+  }
 
   void set_integrator(integrator_t integrator) { m_integrator = integrator; }
 
   // Set gravity damping
-  void set_grav_damping(num_t damping) { m_grav_params.damping = damping; }
+  void set_grav_damping(num_t damping) {
+    m_grav_params.damping = damping;
+    m_acc_valid = false;
+  }
 
   // Set gravitational constant
-  void set_grav_G(num_t G) { m_grav_params.G = G; }
+  void set_grav_G(num_t G) {
+    m_grav_params.G = G;
+    m_acc_valid = false;
+  }
 
   // Set Lennard-Jones potential well depth
-  void set_lj_eps(num_t eps) { m_lj_params.eps = eps; }
+  void set_lj_eps(num_t eps) {
+    m_lj_params.eps = eps;
+    m_acc_valid = false;
+  }
 
   // Set Lennard-Jones zero-potential distance
-  void set_lj_sigma(num_t sigma) { m_lj_params.sigma = sigma; }
+  void set_lj_sigma(num_t sigma) {
+    m_lj_params.sigma = sigma;
+    m_acc_valid = false;
+  }
 
-  // Calls the provided function with body position data
-  template <typename Func, size_t VarId>
-  void with_mapped(read_bufs_t<VarId>, Func&& func) {
-    auto acc = m_bufs.read().gen_host_read_accs(read_bufs_t<VarId>{});
-    func(std::get<0>(acc).get_pointer());
+  // Calls the provided function with a pointer to each of the selected arrays
+  // of body data, all from the newest completed step. Does not wait for
+  // steps in flight: returns false without calling the function when none
+  // has completed.
+  template <typename Func, size_t... VarIds>
+  bool with_mapped(read_bufs_t<VarIds...>, Func&& func) {
+    auto bufs = m_bufs.try_acquire();
+    if (!bufs) {
+      return false;
+    }
+    auto accs = bufs->gen_host_read_accs(read_bufs_t<VarIds...>{});
+    call_with_pointers(func, accs, make_index_sequence<sizeof...(VarIds)>{});
+    return true;
   }
 
  private:
+  template <typename Func, typename Accs, size_t... Is>
+  static void call_with_pointers(Func& func, Accs& accs,
+                                 index_sequence<Is...>) {
+    func(std::get<Is>(accs).get_pointer()...);
+  }
+
+  // Number of bodies in the tiles of the force kernel kernel_name_t, chosen
+  // on its first launch since building the kernel to query its limits is slow
+  template <typename kernel_name_t>
+  size_t tile_size_for() {
+    std::type_index name = typeid(kernel_name_t);
+    auto it = m_tile_sizes.find(name);
+    if (it == m_tile_sizes.end()) {
+      it = m_tile_sizes
+               .emplace(name, choose_tile_size<num_t, kernel_name_t>(m_q))
+               .first;
+    }
+    return it->second;
+  }
+
+  // Launch range of a force kernel: a work-item per body, padded to whole
+  // tiles of tile_size bodies
+  sycl::nd_range<1> tiled_range(size_t tile_size) const {
+    size_t n_tiles = (m_n_bodies + tile_size - 1) / tile_size;
+    return sycl::nd_range<1>(sycl::range<1>(n_tiles * tile_size),
+                             sycl::range<1>(tile_size));
+  }
+
   void internal_step() {
-    m_q.submit([&](cl::sycl::handler& cgh) {
+    m_force_events.clear();
+
+    // Leapfrog carries the velocities half a step behind the positions, so
+    // they are kicked by half a step when switching to or from it
+    bool staggered = m_integrator == integrator_t::LEAPFROG;
+    if (staggered != m_vel_staggered) {
+      kick_half_step(staggered ? num_t(-1) : num_t(1));
+      m_vel_staggered = staggered;
+    }
+
+    // RK4 and velocity Verlet evaluate the forces at new positions of every
+    // body, so their steps run as separate kernels over all bodies
+    cl::sycl::event ev;
+    switch (m_integrator) {
+      case integrator_t::RK4:
+        ev = staged_step<tableau_rk4>();
+        break;
+      case integrator_t::VERLET:
+        ev = verlet_step();
+        break;
+      default:
+        ev = fused_step();
+        break;
+    }
+
+    m_bufs.advance(ev);
+    m_acc_valid = m_integrator == integrator_t::VERLET;
+    m_time += STEP_SIZE;
+  }
+
+  // Advances every body in a single kernel, which evaluates the forces from
+  // the positions at the start of the step
+  cl::sycl::event fused_step() {
+    auto ev = m_q.submit([&](cl::sycl::handler& cgh) {
       // Initialize accessors to body data
       auto reads = m_bufs.read().gen_read_accs(cgh, read_bufs_t<0, 1>{});
       auto writes = m_bufs.write().gen_write_accs(cgh, write_bufs_t<0, 1>{});
@@ -274,46 +605,34 @@ class GravSim {
           num_t G = m_grav_params.G;
           num_t damping = m_grav_params.damping;
 
+          size_t tile_size = tile_size_for<kernel<num_t, 0>>();
+          tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
           cgh.parallel_for<kernel<num_t, 0>>(
-              cl::sycl::range<1>(m_n_bodies), [=](cl::sycl::item<1> item) {
-                auto id = item.get_linear_id();
+              tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+                auto gid = item.get_global_linear_id();
+                // Work-items past the last body only help load the tiles
+                auto id = gid < n_bodies ? gid : n_bodies - 1;
 
                 // Computes the gravitational acceleration on a body using the
                 // chosen constants
                 const auto grav = [&](vec3<num_t>, vec3<num_t> x,
                                       num_t) -> vec3<num_t> {
-                  vec3<num_t> acc(0);
-
-                  for (size_t i = 0; i < n_bodies; i++) {
-                    auto const diff = pos[i] - x;
-                    auto const r =
-                        sycl::sqrt(diff.x() * diff.x() + diff.y() * diff.y() +
-                                   diff.z() * diff.z());
-                    acc += diff /
-                           (r * r * r + num_t(1e24) * num_t(i == id) + damping);
-                  }
-
-                  return G * acc;
+                  return grav_accel(item, tile, pos, n_bodies, id, x, G,
+                                    damping);
                 };
 
-                vec3<num_t> wvelTmp;
-                vec3<num_t> wposTmp;
+                vec3<num_t> wvelTmp = vel[id];
+                vec3<num_t> wposTmp = pos[id];
 
                 // Use the chosen integrator to find new values of position and
                 // velocity
-                if (integrator == integrator_t::EULER) {
-                  std::tie(wvelTmp, wposTmp, std::ignore) =
-                      integrate_step_euler(grav, STEP_SIZE, vel[id], pos[id],
-                                           t);
-
-                } else if (integrator == integrator_t::RK4) {
-                  std::tie(wvelTmp, wposTmp, std::ignore) =
-                      integrate_step_rk4(grav, STEP_SIZE, vel[id], pos[id], t);
+                integrate_body(integrator, grav, STEP_SIZE, t, wvelTmp,
+                               wposTmp);
 
+                if (gid < n_bodies) {
+                  wvel[id] = wvelTmp;
+                  wpos[id] = wposTmp;
                 }
-
-                wvel[id] = wvelTmp;
-                wpos[id] = wposTmp;
               });
         } break;
         case force_t::LENNARD_JONES: {
@@ -322,9 +641,13 @@ class GravSim {
           num_t sigma = m_lj_params.sigma;
           auto A = num_t(24) * eps * sigma;
 
+          size_t tile_size = tile_size_for<kernel<num_t, 1>>();
+          tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
           cgh.parallel_for<kernel<num_t, 1>>(
-              cl::sycl::range<1>(m_n_bodies), [=](cl::sycl::item<1> item) {
-                auto id = item.get_linear_id();
+              tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+                auto gid = item.get_global_linear_id();
+                // Work-items past the last body only help load the tiles
+                auto id = gid < n_bodies ? gid : n_bodies - 1;
 
                 // Computes the acceleration on a body from the sum of
                 // Lennard-Jones
@@ -333,38 +656,21 @@ class GravSim {
                 // parameters
                 const auto force = [&](vec3<num_t>, vec3<num_t> x,
                                        num_t) -> vec3<num_t> {
-                  vec3<num_t> acc(0);
-
-                  for (size_t i = 0; i < n_bodies; i++) {
-                    auto const diff = pos[i] - x;
-                    auto const r =
-                        sycl::sqrt(diff.x() * diff.x() + diff.y() * diff.y() +
-                                   diff.z() * diff.z()) +
-                        num_t(1e24) * num_t(i == id);
-
-                    acc += sycl::pow(r, num_t(-8)) * diff -
-                           num_t(2) * sycl::pow(r, num_t(-14)) * diff;
-                  }
-
-                  return A * acc;
+                  return lj_accel(item, tile, pos, n_bodies, id, x, A);
                 };
 
-                vec3<num_t> wvelTmp;
-                vec3<num_t> wposTmp;
+                vec3<num_t> wvelTmp = vel[id];
+                vec3<num_t> wposTmp = pos[id];
 
                 // Use the chosen integrator to find new values of position and
                 // velocity
-                if (integrator == integrator_t::EULER) {
-                  std::tie(wvelTmp, wposTmp, std::ignore) =
-                      integrate_step_euler(force, STEP_SIZE, vel[id], pos[id],
-                                           t);
-                } else if (integrator == integrator_t::RK4) {
-                  std::tie(wvelTmp, wposTmp, std::ignore) =
-                      integrate_step_rk4(force, STEP_SIZE, vel[id], pos[id], t);
-                }
+                integrate_body(integrator, force, STEP_SIZE, t, wvelTmp,
+                               wposTmp);
 
-                 wvel[id] = wvelTmp;
-                 wpos[id] = wposTmp;
+                if (gid < n_bodies) {
+                  wvel[id] = wvelTmp;
+                  wpos[id] = wposTmp;
+                }
               });
         } break;
         case force_t::COULOMB: {
@@ -377,51 +683,380 @@ class GravSim {
           auto charges_acc = std::get<0>(
               m_coulomb_charges_buf->gen_read_accs(cgh, read_bufs_t<0>{}));
 
+          size_t tile_size = tile_size_for<kernel<num_t, 2>>();
+          tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
           cgh.parallel_for<kernel<num_t, 2>>(
-              cl::sycl::range<1>(m_n_bodies), [=](cl::sycl::item<1> item) {
-                auto id = item.get_linear_id();
+              tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+                auto gid = item.get_global_linear_id();
+                // Work-items past the last body only help load the tiles
+                auto id = gid < n_bodies ? gid : n_bodies - 1;
                 num_t my_charge = charges_acc[id];
 
                 // Computes the gravitational acceleration on a body using the
                 // chosen constants
                 const auto cmb = [&](vec3<num_t>, vec3<num_t> x,
                                      num_t) -> vec3<num_t> {
-                  vec3<num_t> acc(0);
-
-                  for (size_t i = 0; i < n_bodies; i++) {
-                    auto const diff = pos[i] - x;
-                    auto const r =
-                        sycl::sqrt(diff.x() * diff.x() + diff.y() * diff.y() +
-                                   diff.z() * diff.z());
-                    acc += charges_acc[i] * diff /
-                           (r * r * r + num_t(1e24) * num_t(i == id));
-                  }
-
-                  return my_charge * acc;
+                  return coulomb_accel(item, tile, pos, charges_acc, n_bodies,
+                                       id, x, my_charge);
                 };
 
-                vec3<num_t> wvelTmp;
-                vec3<num_t> wposTmp;
+                vec3<num_t> wvelTmp = vel[id];
+                vec3<num_t> wposTmp = pos[id];
 
                 // Use the chosen integrator to find new values of position and
                 // velocity
-                if (integrator == integrator_t::EULER) {
-                  std::tie(wvelTmp, wposTmp, std::ignore) =
-                      integrate_step_euler(cmb, STEP_SIZE, vel[id], pos[id], t);
-                } else if (integrator == integrator_t::RK4) {
-                  std::tie(wvelTmp, wposTmp, std::ignore) =
-                      integrate_step_rk4(cmb, STEP_SIZE, vel[id], pos[id], t);
-                }
+                integrate_body(integrator, cmb, STEP_SIZE, t, wvelTmp,
+                               wposTmp);
 
-                wvel[id] = wvelTmp;
-                wpos[id] = wposTmp;
+                if (gid < n_bodies) {
+                  wvel[id] = wvelTmp;
+                  wpos[id] = wposTmp;
+                }
               });
 
         } break;
       }
     });
+    m_force_events.push_back(ev);
+    return ev;
+  }
 
-    m_bufs.swap();
-    m_time += STEP_SIZE;
+  // Adds, to the command group cgh, a kernel named after name_t which stores
+  // in out the acceleration of every body from the positions pos of all
+  // bodies
+  template <typename name_t, typename pos_t, typename out_t>
+  void accel_kernel(cl::sycl::handler& cgh, pos_t pos, out_t out) {
+    size_t n_bodies = m_n_bodies;
+
+    switch (m_force) {
+      case force_t::GRAVITY: {
+        num_t G = m_grav_params.G;
+        num_t damping = m_grav_params.damping;
+
+        size_t tile_size = tile_size_for<staged_kernel<num_t, name_t, 0>>();
+        tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
+        cgh.parallel_for<staged_kernel<num_t, name_t, 0>>(
+            tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+              auto gid = item.get_global_linear_id();
+              auto id = gid < n_bodies ? gid : n_bodies - 1;
+              vec3<num_t> x = pos[id];
+              auto acc = grav_accel(item, tile, pos, n_bodies, id, x, G,
+                                    damping);
+              if (gid < n_bodies) {
+                out[id] = acc;
+              }
+            });
+      } break;
+      case force_t::LENNARD_JONES: {
+        auto A = num_t(24) * m_lj_params.eps * m_lj_params.sigma;
+
+        size_t tile_size = tile_size_for<staged_kernel<num_t, name_t, 1>>();
+        tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
+        cgh.parallel_for<staged_kernel<num_t, name_t, 1>>(
+            tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+              auto gid = item.get_global_linear_id();
+              auto id = gid < n_bodies ? gid : n_bodies - 1;
+              vec3<num_t> x = pos[id];
+              auto acc = lj_accel(item, tile, pos, n_bodies, id, x, A);
+              if (gid < n_bodies) {
+                out[id] = acc;
+              }
+            });
+      } break;
+      case force_t::COULOMB: {
+        if (!m_coulomb_charges_buf) {
+          throw std::runtime_error("Coulomb charge buffer wasn't initialized!");
+        }
+        auto charges_acc = std::get<0>(
+            m_coulomb_charges_buf->gen_read_accs(cgh, read_bufs_t<0>{}));
+
+        size_t tile_size = tile_size_for<staged_kernel<num_t, name_t, 2>>();
+        tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
+        cgh.parallel_for<staged_kernel<num_t, name_t, 2>>(
+            tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+              auto gid = item.get_global_linear_id();
+              auto id = gid < n_bodies ? gid : n_bodies - 1;
+              vec3<num_t> x = pos[id];
+              auto acc = coulomb_accel(item, tile, pos, charges_acc, n_bodies,
+                                       id, x, charges_acc[id]);
+              if (gid < n_bodies) {
+                out[id] = acc;
+              }
+            });
+      } break;
+    }
+  }
+
+  // Computes the accelerations at the positions of the newest step
+  void compute_accel() {
+    auto& bufs = m_bufs.read();
+    m_force_events.push_back(m_q.submit([&](cl::sycl::handler& cgh) {
+      auto pos = std::get<0>(bufs.gen_read_accs(cgh, read_bufs_t<1>{}));
+      auto accel = std::get<0>(bufs.gen_write_accs(cgh, write_bufs_t<2>{}));
+      accel_kernel<newest_accel>(cgh, pos, accel);
+    }));
+    m_acc_valid = true;
+  }
+
+  // Kicks the velocities of the newest step by sign times half a step, with
+  // the accelerations at its positions. Moves the velocities between the
+  // times of the positions and the half steps leapfrog carries them at.
+  void kick_half_step(num_t sign) {
+    if (!m_acc_valid) {
+      compute_accel();
+    }
+
+    auto& bufs = m_bufs.read();
+    size_t n_bodies = m_n_bodies;
+    num_t kick = sign * STEP_SIZE / num_t(2);
+
+    m_q.submit([&](cl::sycl::handler& cgh) {
+      auto accel = std::get<0>(bufs.gen_read_accs(cgh, read_bufs_t<2>{}));
+      auto vel = std::get<0>(
+          bufs.template gen_accs<sycl::access::mode::read_write>(
+              cgh, write_bufs_t<0>{}));
+
+      cgh.parallel_for<staged_kernel<num_t, half_kick, 0>>(
+          cl::sycl::range<1>(n_bodies), [=](cl::sycl::item<1> item) {
+            auto id = item.get_linear_id();
+            vel[id] += kick * accel[id];
+          });
+    });
+  }
+
+  // Advances every body with velocity Verlet. A first kernel kicks the
+  // velocities of all bodies by half a step and drifts their positions, a
+  // second one computes the accelerations at the new positions of all bodies,
+  // and a third one kicks the velocities by the other half step. The
+  // accelerations are kept for the next step. Returns the event of the kernel
+  // writing the new state.
+  cl::sycl::event verlet_step() {
+    if (!m_acc_valid) {
+      compute_accel();
+    }
+    if (!m_stage_state) {
+      m_stage_state.reset(new stage_state_t(m_n_bodies));
+    }
+
+    auto& init = m_bufs.read();
+    auto& state = *m_stage_state;
+    auto& next = m_bufs.write();
+    size_t n_bodies = m_n_bodies;
+    num_t step = STEP_SIZE;
+
+    // Opening half kick and drift
+    m_q.submit([&](cl::sycl::handler& cgh) {
+      auto reads = init.gen_read_accs(cgh, read_bufs_t<0, 1, 2>{});
+      auto writes = state.gen_write_accs(cgh, write_bufs_t<0, 1>{});
+      auto vel = std::get<0>(reads);
+      auto pos = std::get<1>(reads);
+      auto accel = std::get<2>(reads);
+      auto svel = std::get<0>(writes);
+      auto spos = std::get<1>(writes);
+
+      cgh.parallel_for<staged_kernel<num_t, verlet_drift, 0>>(
+          cl::sycl::range<1>(n_bodies), [=](cl::sycl::item<1> item) {
+            auto id = item.get_linear_id();
+            vec3<num_t> v = vel[id];
+            vec3<num_t> a = accel[id];
+            vec3<num_t> x = pos[id];
+            v += a * (step / num_t(2));
+            svel[id] = v;
+            spos[id] = x + v * step;
+          });
+    });
+
+    // Accelerations at the new positions of all bodies
+    m_force_events.push_back(m_q.submit([&](cl::sycl::handler& cgh) {
+      auto spos = std::get<0>(state.gen_read_accs(cgh, read_bufs_t<1>{}));
+      auto accel = std::get<0>(next.gen_write_accs(cgh, write_bufs_t<2>{}));
+      accel_kernel<verlet_accel>(cgh, spos, accel);
+    }));
+
+    // Closing half kick
+    return m_q.submit([&](cl::sycl::handler& cgh) {
+      auto reads = state.gen_read_accs(cgh, read_bufs_t<0, 1>{});
+      auto accel = std::get<0>(next.gen_read_accs(cgh, read_bufs_t<2>{}));
+      auto writes = next.gen_write_accs(cgh, write_bufs_t<0, 1>{});
+      auto svel = std::get<0>(reads);
+      auto spos = std::get<1>(reads);
+      auto wvel = std::get<0>(writes);
+      auto wpos = std::get<1>(writes);
+
+      cgh.parallel_for<staged_kernel<num_t, verlet_kick, 0>>(
+          cl::sycl::range<1>(n_bodies), [=](cl::sycl::item<1> item) {
+            auto id = item.get_linear_id();
+            vec3<num_t> a = accel[id];
+            vec3<num_t> v = svel[id];
+            vec3<num_t> x = spos[id];
+            wvel[id] = v + a * (step / num_t(2));
+            wpos[id] = x;
+          });
+    });
+  }
+
+  // Advances every body with the explicit Runge-Kutta method of tableau_t.
+  // Every stage computes the state of all bodies in one kernel, then their
+  // derivatives in another, so that the forces of a stage are computed from
+  // the positions of all bodies at that stage. Returns the event of the
+  // kernel writing the new state.
+  template <typename tableau_t>
+  cl::sycl::event staged_step() {
+    constexpr size_t S = tableau_t::stages;
+    using weights_t = rk_weights<num_t, S>;
+    using sycl::access::mode;
+
+    size_t n_bodies = m_n_bodies;
+    if (!m_stage_state) {
+      m_stage_state.reset(new stage_state_t(n_bodies));
+    }
+    if (!m_stage_derivs || m_stage_derivs->size() < S * n_bodies) {
+      m_stage_derivs.reset(new stage_derivs_t(S * n_bodies));
+    }
+    if (m_force == force_t::COULOMB && !m_coulomb_charges_buf) {
+      throw std::runtime_error("Coulomb charge buffer wasn't initialized!");
+    }
+
+    auto& init = m_bufs.read();
+    auto& state = *m_stage_state;
+    auto& derivs = *m_stage_derivs;
+    num_t step = STEP_SIZE;
+
+    for (size_t s = 0; s < S; s++) {
+      weights_t a;
+      for (size_t j = 0; j < S; j++) {
+        a.w[j] = num_t(tableau_t::a(s, j));
+      }
+
+      // State of every body at stage s
+      m_q.submit([&](cl::sycl::handler& cgh) {
+        auto reads = init.gen_read_accs(cgh, read_bufs_t<0, 1>{});
+        auto ks = derivs.gen_read_accs(cgh, read_bufs_t<0, 1>{});
+        auto writes = state.gen_write_accs(cgh, write_bufs_t<0, 1>{});
+        auto vel = std::get<0>(reads);
+        auto pos = std::get<1>(reads);
+        auto kvel = std::get<0>(ks);
+        auto kpos = std::get<1>(ks);
+        auto svel = std::get<0>(writes);
+        auto spos = std::get<1>(writes);
+
+        cgh.parallel_for<staged_kernel<num_t, tableau_t, 0>>(
+            cl::sycl::range<1>(n_bodies), [=](cl::sycl::item<1> item) {
+              auto id = item.get_linear_id();
+              vec3<num_t> v = vel[id];
+              vec3<num_t> x = pos[id];
+              for (size_t j = 0; j < s; j++) {
+                v += (step * a.w[j]) * kvel[j * n_bodies + id];
+                x += (step * a.w[j]) * kpos[j * n_bodies + id];
+              }
+              svel[id] = v;
+              spos[id] = x;
+            });
+      });
+
+      // Derivatives of every body at stage s
+      m_force_events.push_back(m_q.submit([&](cl::sycl::handler& cgh) {
+        auto reads = state.gen_read_accs(cgh, read_bufs_t<0, 1>{});
+        auto svel = std::get<0>(reads);
+        auto spos = std::get<1>(reads);
+        // Only the derivatives of stage s are written
+        auto ks = derivs.template gen_accs<mode::write>(cgh,
+                                                        write_bufs_t<0, 1>{});
+        auto kvel = std::get<0>(ks);
+        auto kpos = std::get<1>(ks);
+        size_t offset = s * n_bodies;
+
+        switch (m_force) {
+          case force_t::GRAVITY: {
+            num_t G = m_grav_params.G;
+            num_t damping = m_grav_params.damping;
+
+            size_t tile_size =
+                tile_size_for<staged_kernel<num_t, tableau_t, 1>>();
+            tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
+            cgh.parallel_for<staged_kernel<num_t, tableau_t, 1>>(
+                tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+                  auto gid = item.get_global_linear_id();
+                  auto id = gid < n_bodies ? gid : n_bodies - 1;
+                  auto acc = grav_accel(item, tile, spos, n_bodies, id,
+                                        spos[id], G, damping);
+                  if (gid < n_bodies) {
+                    kvel[offset + id] = acc;
+                    kpos[offset + id] = svel[id];
+                  }
+                });
+          } break;
+          case force_t::LENNARD_JONES: {
+            auto A = num_t(24) * m_lj_params.eps * m_lj_params.sigma;
+
+            size_t tile_size =
+                tile_size_for<staged_kernel<num_t, tableau_t, 2>>();
+            tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
+            cgh.parallel_for<staged_kernel<num_t, tableau_t, 2>>(
+                tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+                  auto gid = item.get_global_linear_id();
+                  auto id = gid < n_bodies ? gid : n_bodies - 1;
+                  auto acc =
+                      lj_accel(item, tile, spos, n_bodies, id, spos[id], A);
+                  if (gid < n_bodies) {
+                    kvel[offset + id] = acc;
+                    kpos[offset + id] = svel[id];
+                  }
+                });
+          } break;
+          case force_t::COULOMB: {
+            auto charges_acc = std::get<0>(
+                m_coulomb_charges_buf->gen_read_accs(cgh, read_bufs_t<0>{}));
+
+            size_t tile_size =
+                tile_size_for<staged_kernel<num_t, tableau_t, 3>>();
+            tile_acc_t<num_t> tile(sycl::range<1>(tile_size), cgh);
+            cgh.parallel_for<staged_kernel<num_t, tableau_t, 3>>(
+                tiled_range(tile_size), [=](cl::sycl::nd_item<1> item) {
+                  auto gid = item.get_global_linear_id();
+                  auto id = gid < n_bodies ? gid : n_bodies - 1;
+                  auto acc =
+                      coulomb_accel(item, tile, spos, charges_acc, n_bodies, id,
+                                    spos[id], charges_acc[id]);
+                  if (gid < n_bodies) {
+                    kvel[offset + id] = acc;
+                    kpos[offset + id] = svel[id];
+                  }
+                });
+          } break;
+        }
+      }));
+    }
+
+    weights_t b;
+    for (size_t j = 0; j < S; j++) {
+      b.w[j] = num_t(tableau_t::b(j));
+    }
+
+    // New state of every body from the derivatives of all stages
+    return m_q.submit([&](cl::sycl::handler& cgh) {
+      auto reads = init.gen_read_accs(cgh, read_bufs_t<0, 1>{});
+      auto ks = derivs.gen_read_accs(cgh, read_bufs_t<0, 1>{});
+      auto writes = m_bufs.write().gen_write_accs(cgh, write_bufs_t<0, 1>{});
+      auto vel = std::get<0>(reads);
+      auto pos = std::get<1>(reads);
+      auto kvel = std::get<0>(ks);
+      auto kpos = std::get<1>(ks);
+      auto wvel = std::get<0>(writes);
+      auto wpos = std::get<1>(writes);
+
+      cgh.parallel_for<staged_kernel<num_t, tableau_t, 4>>(
+          cl::sycl::range<1>(n_bodies), [=](cl::sycl::item<1> item) {
+            auto id = item.get_linear_id();
+            vec3<num_t> v = vel[id];
+            vec3<num_t> x = pos[id];
+            for (size_t j = 0; j < S; j++) {
+              v += (step * b.w[j]) * kvel[j * n_bodies + id];
+              x += (step * b.w[j]) * kpos[j * n_bodies + id];
+            }
+            wvel[id] = v;
+            wpos[id] = x;
+          });
+    });
   }
 };
@@ -22,12 +22,17 @@
  *
  *  Description:
  *    Implementation of a type trait the indicates whether a type can be
- *    used as a kernel argument or not.
+ *    used as a kernel argument or not, and of helpers that check the size
+ *    of the kernel arguments against the device limit and move large
+ *    arguments to constant memory.
  *
  **************************************************************************/
 
 #include <CL/sycl.hpp>
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <type_traits>
 
 /* Clang identifies itself as GCC, but we really want to be sure that
@@ -64,3 +69,174 @@ struct is_valid_kernel_arg<
     T, typename std::enable_if<is_accessor<T>::value>::type> {
   static constexpr auto value = true;
 };
+
+/* Conservative estimate of the bytes a capture of type T takes in the
+ * parameters of a kernel, and of its alignment. Most types are passed as
+ * they are laid out on the host. */
+template <typename T, typename = void>
+struct kernel_param_size {
+  static constexpr std::size_t size = sizeof(T);
+  static constexpr std::size_t align = alignof(T);
+};
+
+/* The host object of an accessor refers to the bookkeeping of the runtime,
+ * which the device never sees. The device instead receives a pointer and,
+ * at most, an access range, a memory range and an offset of d 64-bit values
+ * each. Neither size bounds the other, so the larger one is used. */
+template <typename U, int d, cl::sycl::access::mode m,
+          cl::sycl::access::target t, cl::sycl::access::placeholder p>
+struct kernel_param_size<cl::sycl::accessor<U, d, m, t, p>> {
+ private:
+  using acc_t = cl::sycl::accessor<U, d, m, t, p>;
+  static constexpr std::size_t device_size =
+      sizeof(std::uint64_t) * (1 + 3 * (d > 0 ? d : 1));
+
+ public:
+  static constexpr std::size_t size =
+      sizeof(acc_t) > device_size ? sizeof(acc_t) : device_size;
+  static constexpr std::size_t align = alignof(acc_t) > alignof(std::uint64_t)
+                                           ? alignof(acc_t)
+                                           : alignof(std::uint64_t);
+};
+
+/* Lays out the parameters Ts after Offset bytes as the members of a struct
+ * would be, and gives the total size padded to the largest alignment. */
+template <std::size_t Offset, std::size_t Align, typename... Ts>
+struct kernel_arg_layout {
+  static constexpr std::size_t value = (Offset + Align - 1) / Align * Align;
+};
+
+template <std::size_t Offset, std::size_t Align, typename T, typename... Ts>
+struct kernel_arg_layout<Offset, Align, T, Ts...> {
+ private:
+  using param = kernel_param_size<T>;
+  static constexpr std::size_t start =
+      (Offset + param::align - 1) / param::align * param::align;
+
+ public:
+  static constexpr std::size_t value =
+      kernel_arg_layout<start + param::size,
+                        (param::align > Align ? param::align : Align),
+                        Ts...>::value;
+};
+
+/* Estimate of the number of bytes passed to the device as kernel parameters
+ * by captures of the given types, including the padding between them. Pass
+ * the types of the captures rather than the kernel functor: the size of a
+ * functor counts the host objects of its accessors. Implementations may add
+ * hidden parameters of their own, so leave some headroom below the limit. */
+template <typename... Ts>
+struct kernel_arg_size {
+  static constexpr std::size_t value = kernel_arg_layout<0, 1, Ts...>::value;
+};
+
+/* True when kernel arguments of the given types fit in the parameter space
+ * of the device. Passing bytes past max_parameter_size fails the launch or,
+ * close to the limit, makes it slow. */
+template <typename... Ts>
+bool fits_parameter_size(const cl::sycl::device& dev) {
+  return kernel_arg_size<Ts...>::value <=
+         dev.get_info<cl::sycl::info::device::max_parameter_size>();
+}
+
+/* Kernel side handle of an argument captured by value. */
+template <typename T>
+class by_value_arg {
+  static_assert(is_valid_kernel_arg<T>::value,
+                "The argument must be a valid kernel argument");
+
+ public:
+  explicit by_value_arg(const T& value) : m_value(value) {}
+
+  const T* get_pointer() const { return &m_value; }
+  const T* operator->() const { return &m_value; }
+
+ private:
+  T m_value;
+};
+
+/* Kernel side handle of an argument read from a constant buffer. Only the
+ * accessor is passed as a kernel parameter. */
+template <typename T>
+class constant_arg {
+  static_assert(is_valid_kernel_arg<T>::value,
+                "The argument must be a valid kernel argument");
+
+ public:
+  using accessor_type =
+      cl::sycl::accessor<T, 1, cl::sycl::access::mode::read,
+                         cl::sycl::access::target::constant_buffer>;
+
+  explicit constant_arg(accessor_type acc) : m_acc(acc) {}
+
+  cl::sycl::constant_ptr<T> get_pointer() const {
+    return m_acc.get_pointer();
+  }
+  cl::sycl::constant_ptr<T> operator->() const { return get_pointer(); }
+
+ private:
+  accessor_type m_acc;
+};
+
+/* Holds a kernel argument of type T and passes it to kernels by value when
+ * it fits in the parameter space of the device, or through a constant buffer
+ * otherwise. reserved_bytes is the size of the other arguments of the
+ * kernels, e.g. kernel_arg_size<accessor_t, int>::value.
+ *
+ * apply() calls the given function object with a by_value_arg<T> or a
+ * constant_arg<T>, so the function object must be generic and the kernels it
+ * submits must be named after the type of the handle:
+ *
+ *   kernel_arg_spill<params> arg(p, q.get_device());
+ *   q.submit([&](cl::sycl::handler& cgh) {
+ *     arg.apply(cgh, [&](auto p) {
+ *       cgh.single_task<kernel<decltype(p)>>([=]() { out[0] = p->a; });
+ *     });
+ *   });
+ *
+ * Both kernels are compiled, the choice between them is made at runtime.
+ * The spilled value must fit in the constant memory of the device, and the
+ * kernel_arg_spill must outlive the kernels that use it. */
+template <typename T>
+class kernel_arg_spill {
+  static_assert(is_valid_kernel_arg<T>::value,
+                "The argument must be a valid kernel argument");
+
+ public:
+  kernel_arg_spill(const T& value, const cl::sycl::device& dev,
+                   std::size_t reserved_bytes = 0)
+      : m_value(value) {
+    // The argument follows the reserved bytes, aligned as it needs
+    const std::size_t align = kernel_param_size<T>::align;
+    const std::size_t start = (reserved_bytes + align - 1) / align * align;
+    if (start + kernel_arg_size<by_value_arg<T>>::value >
+        dev.get_info<cl::sycl::info::device::max_parameter_size>()) {
+      m_buf.reset(new cl::sycl::buffer<T, 1>(
+          static_cast<const T*>(&m_value), cl::sycl::range<1>(1)));
+    }
+  }
+
+  /* The constant buffer uses m_value as its host memory, so the object must
+   * stay where it was constructed. */
+  kernel_arg_spill(const kernel_arg_spill&) = delete;
+  kernel_arg_spill& operator=(const kernel_arg_spill&) = delete;
+
+  /* Whether the argument is passed through a constant buffer. */
+  bool spilled() const { return m_buf != nullptr; }
+
+  template <typename Func>
+  void apply(cl::sycl::handler& cgh, Func&& f) {
+    if (spilled()) {
+      f(constant_arg<T>(
+          m_buf->template get_access<
+              cl::sycl::access::mode::read,
+              cl::sycl::access::target::constant_buffer>(cgh)));
+    } else {
+      f(by_value_arg<T>(m_value));
+    }
+  }
+
+ private:
+  T m_value;
+  std::unique_ptr<cl::sycl::buffer<T, 1>> m_buf;
+};
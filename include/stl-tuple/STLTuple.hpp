@@ -19,7 +19,10 @@
  * STLTuple.h
  *
  * \brief:
- *  Minimal implementation of std::tuple that is standard layout.
+ *  Minimal implementation of std::tuple. The elements are stored in a
+ *  balanced tree of nested aggregates, so the tuple stays standard layout
+ *  and accessing an element only instantiates templates for the nodes on
+ *  its path.
  *
   Authors:
  *
@@ -32,6 +35,9 @@
 #ifndef STL_TUPLE_HPP
 #define STL_TUPLE_HPP
 
+#include <cstddef>
+#include <type_traits>
+
 namespace utility {
 namespace tuple {
 /// \struct StaticIf
@@ -45,22 +51,135 @@ struct StaticIf<true, T> {
   typedef T type;
 };
 
+/// \struct IndexList
+/// \brief Creates a list of index from the elements in the tuple
+/// \tparam Is... a list of index from [0 to sizeof...(tuple elements))
+template <size_t... Is>
+struct IndexList {};
+
+/// \struct JoinIndexList
+/// \brief Joins two index lists, adding the size of the first one to the
+/// indices of the second one.
+template <class, class>
+struct JoinIndexList;
+
+template <size_t... Is, size_t... Js>
+struct JoinIndexList<IndexList<Is...>, IndexList<Js...>> {
+  typedef IndexList<Is..., (sizeof...(Is) + Js)...> type;
+};
+
+/// \struct MakeIndexList
+/// \brief Generates the index list [0, N) by joining the lists of the two
+/// halves, so the instantiation depth is logarithmic in N.
+template <size_t N>
+struct MakeIndexList {
+  typedef typename JoinIndexList<
+      typename MakeIndexList<N / 2>::type,
+      typename MakeIndexList<N - N / 2>::type>::type type;
+};
+
+template <>
+struct MakeIndexList<0> {
+  typedef IndexList<> type;
+};
+
+template <>
+struct MakeIndexList<1> {
+  typedef IndexList<0> type;
+};
+
+/// \struct OffsetIndexList
+/// \brief Adds MIN to every index of the list.
+template <size_t MIN, class>
+struct OffsetIndexList;
+
+template <size_t MIN, size_t... Is>
+struct OffsetIndexList<MIN, IndexList<Is...>> {
+  typedef IndexList<(MIN + Is)...> type;
+};
+
+/// \struct RangeBuilder
+/// \brief Collects internal details for generating index ranges [MIN, MAX)
+/// \tparam MIN is the starting index in the tuple
+/// \tparam MAX is the size of the tuple
+template <size_t MIN, size_t MAX>
+struct RangeBuilder {
+  static_assert(MIN <= MAX, "The index range cannot be negative");
+  typedef typename OffsetIndexList<
+      MIN, typename MakeIndexList<MAX - MIN>::type>::type type;
+};
+
+/// \brief IndexRange that returns a [MIN, MAX) index range
+/// \tparam MIN is the starting index in the tuple
+/// \tparam MAX is the size of the tuple
+template <size_t MIN, size_t MAX>
+struct IndexRange : RangeBuilder<MIN, MAX>::type {};
+
+/// \struct TypeWrapper
+/// \brief Carries a type through an unevaluated function call.
+template <class T>
+struct TypeWrapper {
+  typedef T type;
+};
+
+/// \struct TypeLeaf
+/// \brief Empty base class tagging the element type T of the tuple with its
+/// index I. It holds no data, so it only serves to look types up.
+template <size_t I, class T>
+struct TypeLeaf {};
+
+/// \struct TypeMap
+/// \brief Maps every index of the tuple to its element type through its
+/// \ref TypeLeaf base classes.
+template <class, class... Ts>
+struct TypeMap;
+
+template <size_t... Is, class... Ts>
+struct TypeMap<IndexList<Is...>, Ts...> : TypeLeaf<Is, Ts>... {};
+
+/// leaf_type
+/// \brief Deduces the element type at index k of a \ref TypeMap from its
+/// base classes. Only used in unevaluated contexts.
+template <size_t k, class T>
+TypeWrapper<T> leaf_type(const TypeLeaf<k, T>&);
+
+/// \struct TupleNode
+/// \brief Stores the elements [B, E) of the tuple whose types are given by
+/// Map. Nodes of more than one element hold the two halves of their range
+/// as members, so the storage is a balanced tree of aggregates: it is
+/// standard layout whenever the elements are, and an element is reached
+/// through a logarithmic number of nodes.
+template <size_t B, size_t E, class Map, size_t N = E - B>
+struct TupleNode {
+  static constexpr size_t M = B + N / 2;
+  TupleNode<B, M, Map> left;
+  TupleNode<M, E, Map> right;
+};
+
+template <size_t B, size_t E, class Map>
+struct TupleNode<B, E, Map, 1> {
+  typedef typename decltype(
+      leaf_type<B>(*static_cast<Map*>(nullptr)))::type value_type;
+  value_type value;
+};
+
+template <size_t B, size_t E, class Map>
+struct TupleNode<B, E, Map, 0> {};
+
 /// \struct Tuple
 /// \brief is a fixed-size collection of heterogeneous values
-/// \ztparam Ts...	-	the types of the elements that the tuple stores.
+/// \tparam Ts...	-	the types of the elements that the tuple stores.
 /// Empty list is supported.
 template <class... Ts>
-struct Tuple {};
-
-/// \brief specialisation of the \ref Tuple class when the tuple has at least
-/// one element.
-/// \tparam T : the type of the first element in the tuple.
-/// \tparam Ts... the rest of the elements in the tuple. Ts... can be empty.
-template <class T, class... Ts>
-struct Tuple<T, Ts...> {
-  Tuple(T t, Ts... ts) : head(t), tail(ts...) {}
-  T head;
-  Tuple<Ts...> tail;
+struct Tuple {
+  typedef TypeMap<typename RangeBuilder<0, sizeof...(Ts)>::type, Ts...>
+      map_type;
+  typedef TupleNode<0, sizeof...(Ts), map_type> storage_type;
+
+  // Brace elision spreads the elements over the leaves of the tree in order
+  Tuple(Ts... ts) : storage{ts...} {}
+
+  storage_type storage;
 };
 
 template <typename, typename>
@@ -71,18 +190,44 @@ struct concat_tuple<Tuple<Ts...>, Tuple<Us...>> {
   using type = Tuple<Ts..., Us...>;
 };
 
+///\ struct ElemTypeHolder
+/// \brief ElemTypeHolder class is used to specify the types of the
+/// elements inside the tuple
+/// \tparam size_t the number of elements inside the tuple
+/// \tparam class the tuple class
+template <size_t, class>
+struct ElemTypeHolder;
+
+/// \brief specialisation of the \ref ElemTypeHolder class for a tuple. The
+/// type is found by overload resolution on the \ref TypeLeaf at index k
+/// rather than by recursion on the element types.
+/// \tparam k is the Kth element in the tuple
+/// \tparam Ts... are the type of the elements in the tuple.
+template <size_t k, class... Ts>
+struct ElemTypeHolder<k, Tuple<Ts...>> {
+  static_assert(k < sizeof...(Ts),
+                "The requseted value is bigger than the size of the tuple");
+  typedef typename decltype(leaf_type<k>(
+      *static_cast<typename Tuple<Ts...>::map_type*>(nullptr)))::type type;
+};
+
 template <typename T>
 struct remove_last_type;
 
-template <typename T>
-struct remove_last_type<Tuple<T>> {
-  using type = Tuple<>;
+template <typename, typename>
+struct remove_last_type_base;
+
+template <typename... Ts, size_t... Is>
+struct remove_last_type_base<Tuple<Ts...>, IndexList<Is...>> {
+  using type = Tuple<typename ElemTypeHolder<Is, Tuple<Ts...>>::type...>;
 };
 
-template <typename T, typename... Args>
-struct remove_last_type<Tuple<T, Args...>> {
-  using type = typename concat_tuple<
-      Tuple<T>, typename remove_last_type<Tuple<Args...>>::type>::type;
+/// \brief removes the last element type of a non-empty tuple, keeping the
+/// first sizeof...(Ts) - 1 element types.
+template <typename T, typename... Ts>
+struct remove_last_type<Tuple<T, Ts...>> {
+  using type = typename remove_last_type_base<
+      Tuple<T, Ts...>, typename RangeBuilder<0, sizeof...(Ts)>::type>::type;
 };
 
 template <typename T>
@@ -93,69 +238,68 @@ struct remove_first_type<Tuple<T, Ts...>> {
   typedef Tuple<Ts...> type;
 };
 
-///\ struct ElemTypeHolder
-/// \brief ElemTypeHolder class is used to specify the types of the
-/// elements inside the tuple
-/// \tparam size_t the number of elements inside the tuple
-/// \tparam class the tuple class
-template <size_t, class>
-struct ElemTypeHolder;
+/// \struct TupleChild
+/// \brief Selects the left or the right child of a \ref TupleNode.
+template <bool Left>
+struct TupleChild {
+  template <class Node>
+  static auto get(Node& n) -> decltype((n.left)) {
+    return n.left;
+  }
+};
 
-/// \brief specialisation of the \ref ElemTypeHolder class when the number of
-/// elements inside the tuple is 1
-template <class T, class... Ts>
-struct ElemTypeHolder<0, Tuple<T, Ts...>> {
-  typedef T type;
+template <>
+struct TupleChild<false> {
+  template <class Node>
+  static auto get(Node& n) -> decltype((n.right)) {
+    return n.right;
+  }
 };
 
-/// \brief specialisation of the \ref ElemTypeHolder class when the number of
-/// elements inside the tuple is bigger than 1. It recursively calls itself to
-/// detect the type of each element in the tuple
-/// \tparam T : the type of the first element in the tuple.
-/// \tparam Ts... the rest of the elements in the tuple. Ts... can be empty.
-/// \tparam K is the Kth element in the tuple
-template <size_t k, class T, class... Ts>
-struct ElemTypeHolder<k, Tuple<T, Ts...>> {
-  typedef typename ElemTypeHolder<k - 1, Tuple<Ts...>>::type type;
+/// \struct TupleGetter
+/// \brief Walks down the tree of \ref TupleNode to the leaf holding the Kth
+/// element, taking the half whose range contains k at each node.
+template <size_t k, class Node>
+struct TupleGetter;
+
+template <size_t k, size_t B, size_t E, class Map>
+struct TupleGetter<k, TupleNode<B, E, Map, 1>> {
+  template <class Node>
+  static auto get(Node& n) -> decltype((n.value)) {
+    return n.value;
+  }
 };
 
-/// get
-/// \brief Extracts the first element from the tuple.
-/// K=0 represents the first element of the tuple. The tuple cannot be empty.
-/// \tparam Ts... are the type of the elements in the tuple.
-/// \param t is the tuple whose contents to extract
-/// \return  typename ElemTypeHolder<0, Tuple<Ts...> >::type &>::type
-
-#define TERMINATE_CONDS_TUPLE_GET(CVQual)                                      \
-  template <size_t k, class... Ts>                                             \
-  typename StaticIf<k == 0, CVQual                                             \
-                    typename ElemTypeHolder<0, Tuple<Ts...>>::type&>::type     \
-  get(CVQual Tuple<Ts...>& t) {                                                \
-    static_assert(sizeof...(Ts) != 0,                                          \
-                  "The requseted value is bigger than the size of the tuple"); \
-    return t.head;                                                             \
+template <size_t k, size_t B, size_t E, class Map, size_t N>
+struct TupleGetter<k, TupleNode<B, E, Map, N>> {
+  static constexpr size_t M = TupleNode<B, E, Map, N>::M;
+  typedef TupleGetter<k, TupleNode<(k < M ? B : M), (k < M ? M : E), Map>>
+      child_getter;
+
+  template <class Node>
+  static auto get(Node& n)
+      -> decltype(child_getter::get(TupleChild<(k < M)>::get(n))) {
+    return child_getter::get(TupleChild<(k < M)>::get(n));
   }
+};
 
-TERMINATE_CONDS_TUPLE_GET(const)
-TERMINATE_CONDS_TUPLE_GET()
-#undef TERMINATE_CONDS_TUPLE_GET
 /// get
-/// \brief Extracts the Kth element from the tuple.
+/// \brief Extracts the Kth element from the tuple by walking down its
+/// storage tree.
 ///\tparam K is an integer value in [0,sizeof...(Types)).
-/// \tparam T is the (sizeof...(Types) -(K+1)) element in the tuple
 /// \tparam Ts... are the type of the elements  in the tuple.
 /// \param t is the tuple whose contents to extract
-/// \return  typename ElemTypeHolder<K, Tuple<Ts...> >::type &>::type
-#define RECURSIVE_TUPLE_GET(CVQual)                                           \
-  template <size_t k, class T, class... Ts>                                   \
-  typename StaticIf<k != 0, CVQual                                            \
-                    typename ElemTypeHolder<k, Tuple<T, Ts...>>::type&>::type \
-  get(CVQual Tuple<T, Ts...>& t) {                                            \
-    return utility::tuple::get<k - 1>(t.tail);                                \
+/// \return  typename ElemTypeHolder<K, Tuple<Ts...> >::type &
+#define TUPLE_GET(CVQual)                                                     \
+  template <size_t k, class... Ts>                                            \
+  CVQual typename ElemTypeHolder<k, Tuple<Ts...>>::type& get(                 \
+      CVQual Tuple<Ts...>& t) {                                               \
+    return TupleGetter<k, typename Tuple<Ts...>::storage_type>::get(          \
+        t.storage);                                                           \
   }
-RECURSIVE_TUPLE_GET(const)
-RECURSIVE_TUPLE_GET()
-#undef RECURSIVE_TUPLE_GET
+TUPLE_GET(const)
+TUPLE_GET()
+#undef TUPLE_GET
 
 /// make_tuple
 /// \brief Creates a tuple object, deducing the target type from the types of
@@ -178,45 +322,6 @@ static constexpr size_t size(Tuple<Args...>&) {
   return sizeof...(Args);
 }
 
-/// \struct IndexList
-/// \brief Creates a list of index from the elements in the tuple
-/// \tparam Is... a list of index from [0 to sizeof...(tuple elements))
-template <size_t... Is>
-struct IndexList {};
-
-/// \struct RangeBuilder
-/// \brief Collects internal details for generating index ranges [MIN, MAX)
-/// Declare primary template for index range builder
-/// \tparam MIN is the starting index in the tuple
-/// \tparam N represents sizeof..(elemens)- sizeof...(Is)
-/// \tparam Is... are the list of generated index so far
-template <size_t MIN, size_t N, size_t... Is>
-struct RangeBuilder;
-
-/// \brief base Step: Specialisation of the \ref RangeBuilder when the
-/// MIN==MAX. In this case the Is... is [0 to sizeof...(tuple elements))
-/// \tparam MIN is the starting index of the tuple
-/// \tparam Is is [0 to sizeof...(tuple elements))
-template <size_t MIN, size_t... Is>
-struct RangeBuilder<MIN, MIN, Is...> {
-  typedef IndexList<Is...> type;
-};
-
-/// Induction step: Specialisation of the RangeBuilder class when N!=MIN
-/// in this case we are recursively subtracting N by one and adding one
-/// index to Is... list until MIN==N
-/// \tparam MIN is the starting index in the tuple
-/// \tparam N represents sizeof..(elemens)- sizeof...(Is)
-/// \tparam Is... are the list of generated index so far
-template <size_t MIN, size_t N, size_t... Is>
-struct RangeBuilder : public RangeBuilder<MIN, N - 1, N - 1, Is...> {};
-
-/// \brief IndexRange that returns a [MIN, MAX) index range
-/// \tparam MIN is the starting index in the tuple
-/// \tparam MAX is the size of the tuple
-template <size_t MIN, size_t MAX>
-struct IndexRange : RangeBuilder<MIN, MAX>::type {};
-
 /// append_base
 /// \brief unpacking the elements of the input tuple t and creating a new tuple
 /// by adding element a at the end of it.
@@ -278,6 +383,11 @@ Tuple<Args1..., Args2...> append(Tuple<Args1...> t1, Tuple<Args2...> t2) {
                                      IndexRange<0, sizeof...(Args2)>());
 }
 
+// Tuples are passed to kernels, so they must be standard layout whenever
+// their elements are
+static_assert(std::is_standard_layout<Tuple<int, float, double>>::value,
+              "Tuple must be standard layout");
+
 }  // namespace tuple
 }  // namespace utility
 #endif  // STL_TUPLE_HPP
\ No newline at end of file
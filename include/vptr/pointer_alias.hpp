@@ -22,7 +22,7 @@
  *
  *  Description:
  *    Alias functions that obtain a pointer of the given type from an
- *    accessor.
+ *    accessor, and vector views over the memory of an accessor.
  *
  * Authors:
  *
@@ -33,6 +33,8 @@
 
 #include <CL/sycl.hpp>
 
+#include <cstddef>
+
 #ifndef CL_SYCL_POINTER_ALIAS
 #define CL_SYCL_POINTER_ALIAS
 
@@ -51,6 +53,105 @@ T* get_host_ptr_as(AccessorT& acc) {
   return reinterpret_cast<T*>(acc.get_pointer());
 }
 
+/* Loads the vector of N elements starting at ptr. ptr must be aligned to
+ * the size of the vector. */
+template <int N, typename T>
+cl::sycl::vec<T, N> vload(cl::sycl::global_ptr<T> ptr) {
+  return *reinterpret_cast<
+      typename cl::sycl::global_ptr<cl::sycl::vec<T, N>>::pointer_t>(
+      ptr.get());
+}
+
+/* Stores the vector of N elements starting at ptr. ptr must be aligned to
+ * the size of the vector. */
+template <int N, typename T>
+void vstore(const cl::sycl::vec<T, N>& v, cl::sycl::global_ptr<T> ptr) {
+  *reinterpret_cast<
+      typename cl::sycl::global_ptr<cl::sycl::vec<T, N>>::pointer_t>(
+      ptr.get()) = v;
+}
+
+/* A view of count elements of type T as vectors of N elements. The elements
+ * before the first address aligned to the size of the vector form a scalar
+ * prologue, and those after the last whole vector a scalar epilogue. When
+ * the elements are not aligned to sizeof(T), every element is scalar. */
+template <typename T, int N>
+class vec_view {
+  static_assert(N == 2 || N == 4 || N == 8 || N == 16,
+                "The vector size must be 2, 4, 8 or 16");
+
+ public:
+  using pointer_t = typename cl::sycl::global_ptr<T>::pointer_t;
+  using vec_t = cl::sycl::vec<T, N>;
+
+  vec_view(pointer_t ptr, size_t count)
+      : m_ptr(ptr), m_count(count), m_prologue(count), m_vecs(0) {
+    const size_t addr = reinterpret_cast<size_t>(ptr);
+    if (addr % sizeof(T) == 0) {
+      const size_t misalign = (addr / sizeof(T)) % N;
+      const size_t prologue = misalign == 0 ? 0 : N - misalign;
+      if (prologue < count) {
+        m_prologue = prologue;
+        m_vecs = (count - prologue) / N;
+      }
+    }
+  }
+
+  /* Number of whole vectors in the view. */
+  size_t vec_count() const { return m_vecs; }
+
+  /* Number of elements in the prologue and the epilogue. */
+  size_t scalar_count() const { return m_count - m_vecs * N; }
+
+  vec_t load(size_t i) const { return vload<N>(vec_ptr(i)); }
+
+  void store(size_t i, const vec_t& v) const { vstore<N>(v, vec_ptr(i)); }
+
+  /* The i-th element outside the vectors: the prologue followed by the
+   * epilogue. */
+  T& scalar(size_t i) const {
+    return m_ptr[i < m_prologue ? i : i + m_vecs * N];
+  }
+
+  /* Applies vec_op to every vector and scalar_op to every other element, for
+   * the work-item id of a launch of stride work-items. Both operations
+   * receive a reference to the data. */
+  template <typename ScalarOp, typename VecOp>
+  void for_each(size_t id, size_t stride, ScalarOp scalar_op,
+                VecOp vec_op) const {
+    for (size_t i = id; i < m_vecs; i += stride) {
+      vec_t v = load(i);
+      vec_op(v);
+      store(i, v);
+    }
+    for (size_t i = id; i < scalar_count(); i += stride) {
+      scalar_op(scalar(i));
+    }
+  }
+
+ private:
+  cl::sycl::global_ptr<T> vec_ptr(size_t i) const {
+    return cl::sycl::global_ptr<T>(m_ptr + m_prologue + i * N);
+  }
+
+  pointer_t m_ptr;
+  size_t m_count;
+  size_t m_prologue;
+  size_t m_vecs;
+};
+
+/* Vector view of count elements of type T starting offset bytes into the
+ * memory of the accessor, e.g. the offset of a virtual pointer given by
+ * PointerMapper::get_offset. */
+template <typename T, int N, typename AccessorT>
+vec_view<T, N> get_device_vec_view(AccessorT& acc, size_t offset,
+                                   size_t count) {
+  return vec_view<T, N>(
+      reinterpret_cast<typename vec_view<T, N>::pointer_t>(
+          get_device_ptr_as<char>(acc) + offset),
+      count);
+}
+
 }  // namespace codeplay
 }  // namespace sycl
 }  // namespace cl
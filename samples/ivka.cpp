@@ -22,7 +22,8 @@
  *
  *  Description:
  *    Sample showing the different kinds of things that are valid and not
- *    valid when used as kernel args.
+ *    valid when used as kernel args, and passing an argument too large for
+ *    the kernel parameters through constant memory.
  *
  **************************************************************************/
 
@@ -49,4 +50,49 @@ static_assert(is_valid_kernel_arg<Foo>::value, "");
 static_assert(!is_valid_kernel_arg<Bar>::value, "");
 static_assert(!is_valid_kernel_arg<cl::sycl::queue>::value, "");
 
-int main() { return 0; }
+static_assert(kernel_arg_size<Foo>::value == sizeof(int), "");
+/* Parameters are padded as the members of a struct would be. */
+static_assert(kernel_arg_size<Foo, double>::value == 2 * sizeof(double), "");
+/* Accessors count at least a pointer and their ranges and offset. */
+static_assert(
+    kernel_arg_size<accessor<int, 2, mode::read, target::global_buffer>>::value
+        >= 7 * sizeof(std::uint64_t),
+    "");
+
+/* Larger than the 1024 bytes of parameters OpenCL guarantees. */
+struct Coefficients {
+  float c[1024];
+};
+
+template <typename>
+class poly;
+
+int main() {
+  queue q;
+  Coefficients coeffs;
+  for (int i = 0; i < 1024; i++) {
+    coeffs.c[i] = 1.0f;
+  }
+
+  using write_acc_t = accessor<float, 1, mode::discard_write,
+                               target::global_buffer>;
+  kernel_arg_spill<Coefficients> arg(coeffs, q.get_device(),
+                                     kernel_arg_size<write_acc_t>::value);
+  float result = 0.0f;
+  {
+    buffer<float, 1> buf(&result, range<1>(1));
+    q.submit([&](handler& cgh) {
+      auto out = buf.get_access<mode::discard_write>(cgh);
+      arg.apply(cgh, [&](auto c) {
+        cgh.single_task<poly<decltype(c)>>([=]() {
+          float sum = 0.0f;
+          for (int i = 0; i < 1024; i++) {
+            sum += c->c[i];
+          }
+          out[0] = sum;
+        });
+      });
+    });
+  }
+  return result == 1024.0f ? 0 : 1;
+}
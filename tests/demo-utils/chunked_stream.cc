@@ -0,0 +1,71 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2017 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *   chunked_stream.cc
+ *
+ *  Description:
+ *   Tests for streaming host arrays through the device in chunks
+ *
+ **************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include <CL/sycl.hpp>
+
+#include <tuple>
+#include <vector>
+
+#include "chunked_stream.hpp"
+
+class offset_chunk;
+
+static_assert(!bufs_overlap(read_bufs_t<0, 1>{}, write_bufs_t<2>{}), "");
+static_assert(bufs_overlap(read_bufs_t<0, 1>{}, write_bufs_t<1>{}), "");
+
+TEST(chunked_stream, round_trip) {
+  // The last chunk is partial
+  const size_t n = 1000;
+  const size_t chunk = 128;
+  std::vector<float> in(n);
+  std::vector<float> out(n, -1.0f);
+  for (size_t i = 0; i < n; i++) {
+    in[i] = static_cast<float>(i % 97);
+  }
+
+  cl::sycl::queue q;
+  ChunkedStream<float, float> stream(q, chunk);
+  ASSERT_EQ(stream.chunk_size(), chunk);
+  stream.run(std::make_tuple(in.data(), out.data()), n, read_bufs_t<0>{},
+             write_bufs_t<1>{},
+             [](cl::sycl::handler& cgh, auto reads, auto writes, size_t count,
+                size_t offset) {
+               auto r = std::get<0>(reads);
+               auto w = std::get<0>(writes);
+               float base = static_cast<float>(offset);
+               cgh.parallel_for<offset_chunk>(
+                   cl::sycl::range<1>(count), [=](cl::sycl::id<1> i) {
+                     w[i] = 2.0f * r[i] + base;
+                   });
+             });
+
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_EQ(out[i], 2.0f * in[i] + static_cast<float>(i - i % chunk));
+  }
+}
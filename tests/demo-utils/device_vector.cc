@@ -0,0 +1,117 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2017 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *   device_vector.cc
+ *
+ *  Description:
+ *   Tests for the growth paths of the growable device vector
+ *
+ **************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include <CL/sycl.hpp>
+
+#include <vector>
+
+#include "device_vector.hpp"
+
+using sycl_acc_mode = cl::sycl::access::mode;
+
+// Reads the elements in use back to the host
+template <typename T>
+std::vector<T> to_host(device_vector<T>& v) {
+  auto acc = v.get_buffer().template get_access<sycl_acc_mode::read>();
+  std::vector<T> res(v.size());
+  for (size_t i = 0; i < v.size(); i++) {
+    res[i] = acc[i];
+  }
+  return res;
+}
+
+TEST(device_vector, empty) {
+  cl::sycl::queue q;
+  device_vector<int> v(q);
+  ASSERT_TRUE(v.empty());
+  ASSERT_EQ(v.size(), 0u);
+  ASSERT_EQ(v.capacity(), 1u);
+
+  // Accessors to an empty vector are still valid
+  q.submit([&](cl::sycl::handler& cgh) {
+    auto acc = v.get_access<sycl_acc_mode::read_write>(cgh);
+    (void)acc;
+  });
+  q.wait_and_throw();
+}
+
+TEST(device_vector, resize) {
+  cl::sycl::queue q;
+  device_vector<int> v(q, 3);
+  ASSERT_EQ(v.size(), 3u);
+  ASSERT_EQ(to_host(v), std::vector<int>(3, 0));
+
+  // Growing past the capacity at least doubles it
+  v.resize(4, 7);
+  ASSERT_EQ(v.size(), 4u);
+  ASSERT_EQ(v.capacity(), 6u);
+  ASSERT_EQ(to_host(v), (std::vector<int>{0, 0, 0, 7}));
+
+  // Shrinking keeps the capacity, and growing back within it refills
+  v.resize(2);
+  v.resize(5, 9);
+  ASSERT_EQ(v.capacity(), 6u);
+  ASSERT_EQ(to_host(v), (std::vector<int>{0, 0, 9, 9, 9}));
+}
+
+TEST(device_vector, reserve) {
+  cl::sycl::queue q;
+  device_vector<int> v(q);
+  v.resize(2, 3);
+  v.reserve(20);
+  ASSERT_EQ(v.size(), 2u);
+  ASSERT_EQ(v.capacity(), 20u);
+  ASSERT_EQ(to_host(v), (std::vector<int>{3, 3}));
+
+  // Reserving less than the capacity does nothing
+  v.reserve(5);
+  ASSERT_EQ(v.capacity(), 20u);
+}
+
+TEST(device_vector, push_back_bulk) {
+  cl::sycl::queue q;
+  device_vector<int> v(q);
+  std::vector<int> expected;
+  const std::vector<int> data = {1, 2, 3, 4, 5};
+  for (int round = 0; round < 4; round++) {
+    v.push_back_bulk(data.data(), data.size());
+    expected.insert(expected.end(), data.begin(), data.end());
+  }
+  q.wait_and_throw();
+  ASSERT_EQ(v.size(), expected.size());
+  ASSERT_GE(v.capacity(), v.size());
+  ASSERT_EQ(to_host(v), expected);
+
+  v.push_back_bulk(data.data(), 0);
+  ASSERT_EQ(v.size(), expected.size());
+
+  v.clear();
+  ASSERT_TRUE(v.empty());
+  ASSERT_EQ(v.capacity(), 20u);
+}
@@ -0,0 +1,140 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2017 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *   integrator.cc
+ *
+ *  Description:
+ *   Tests for the convergence of the generic Runge-Kutta integrators, the
+ *   tolerance of the adaptive steps and the convergence and energy of velocity
+ *   Verlet, on the harmonic oscillator y'' = -y
+ *
+ **************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "integrator.hpp"
+
+namespace {
+// y'' = -y, solved by y = sin(t) from y(0) = 0, y'(0) = 1
+const auto oscillator = [](double, double y, double) { return -y; };
+
+// Error of y(1) after n steps of the method of tableau_t
+template <typename tableau_t>
+double rk_error(int n) {
+  double v = 1, y = 0, t = 0;
+  double step = 1.0 / n;
+  for (int i = 0; i < n; i++) {
+    std::tie(v, y, t) =
+        integrate_step_rk<tableau_t>(oscillator, step, v, y, t);
+  }
+  return std::abs(y - std::sin(1.0));
+}
+
+// Halving the step divides the error by about 2^order
+template <typename tableau_t>
+void check_order() {
+  double rate = std::log2(rk_error<tableau_t>(20) / rk_error<tableau_t>(40));
+  ASSERT_NEAR(rate, tableau_t::order, 0.25);
+}
+
+// Error of y(1) after n steps of velocity Verlet
+double verlet_error(int n) {
+  double a = 0, v = 1, y = 0, t = 0;
+  double step = 1.0 / n;
+  for (int i = 0; i < n; i++) {
+    std::tie(a, v, y, t) = integrate_step_verlet(oscillator, step, a, v, y, t);
+  }
+  return std::abs(y - std::sin(1.0));
+}
+
+double error_norm(std::tuple<double, double, double> const& e) {
+  return std::abs(std::get<0>(e)) + std::abs(std::get<1>(e));
+}
+}  // namespace
+
+TEST(integrator, rk2_order) { check_order<tableau_rk2>(); }
+
+TEST(integrator, rk3_order) { check_order<tableau_rk3>(); }
+
+TEST(integrator, rk4_order) { check_order<tableau_rk4>(); }
+
+TEST(integrator, dopri5_order) { check_order<tableau_dopri5>(); }
+
+TEST(integrator, rk4_matches_classic) {
+  double v = 1, y = 0, t = 0;
+  double cv = 1, cy = 0, ct = 0;
+  for (int i = 0; i < 10; i++) {
+    std::tie(v, y, t) =
+        integrate_step_rk<tableau_rk4>(oscillator, 0.1, v, y, t);
+    std::tie(cv, cy, ct) = integrate_step_rk4(oscillator, 0.1, cv, cy, ct);
+  }
+  ASSERT_NEAR(y, cy, 1e-14);
+  ASSERT_NEAR(v, cv, 1e-14);
+}
+
+TEST(integrator, adaptive_meets_tolerance) {
+  const double tol = 1e-8;
+  double v = 1, y = 0, t = 0;
+  double step = 0.5;
+  while (t < 1) {
+    double nv, ny, nt;
+    bool accepted = false;
+    std::tie(nv, ny, nt) = integrate_step_adaptive<tableau_dopri5>(
+        oscillator, step, tol, error_norm, accepted, v, y, t);
+    ASSERT_TRUE(accepted);
+
+    // The exact solution from the start of the step
+    double h = nt - t;
+    double ey = y * std::cos(h) + v * std::sin(h);
+    double ev = v * std::cos(h) - y * std::sin(h);
+    ASSERT_LE(std::abs(ny - ey) + std::abs(nv - ev), tol);
+    std::tie(v, y, t) = std::make_tuple(nv, ny, nt);
+  }
+}
+
+TEST(integrator, adaptive_reports_rejection) {
+  double step = 1;
+  bool accepted = true;
+  integrate_step_adaptive<tableau_rk3>(oscillator, step, 1e-300, error_norm,
+                                       accepted, 1.0, 0.0, 0.0);
+  ASSERT_FALSE(accepted);
+  ASSERT_LT(step, 1.0);
+}
+
+TEST(integrator, verlet_order) {
+  double rate = std::log2(verlet_error(20) / verlet_error(40));
+  ASSERT_NEAR(rate, 2, 0.25);
+}
+
+TEST(integrator, verlet_keeps_energy) {
+  // The energy of a symplectic method oscillates around the exact one, by
+  // O(step^2), instead of drifting away over many periods
+  double a = 0, v = 1, y = 0, t = 0;
+  double max_error = 0;
+  for (int i = 0; i < 10000; i++) {
+    std::tie(a, v, y, t) = integrate_step_verlet(oscillator, 0.1, a, v, y, t);
+    max_error = std::max(max_error, std::abs((v * v + y * y) / 2 - 0.5));
+  }
+  ASSERT_LT(max_error, 0.01);
+}
@@ -120,3 +120,50 @@ TEST(accessor, two_buffers) {
     ASSERT_EQ(pMap.count(), 0u);
   }
 }
+
+TEST(accessor, vec_view) {
+  PointerMapper pMap;
+  {
+    const size_t size = 103;
+    float* myPtr = static_cast<float*>(SYCLmalloc(size * sizeof(float), pMap));
+    ASSERT_EQ(pMap.count(), 1u);
+
+    {
+      auto hostAcc = pMap.get_access<sycl_acc_rw, sycl_acc_host>(myPtr);
+      float* hostPtr = cl::sycl::codeplay::get_host_ptr_as<float>(hostAcc);
+      for (size_t i = 0; i < size; i++) {
+        hostPtr[i] = static_cast<float>(i);
+      }
+    }
+
+    // Starting one float into the buffer leaves a three element prologue
+    float* viewPtr = myPtr + 1;
+    const size_t offset = pMap.get_offset(viewPtr);
+    const size_t count = size - 1;
+    const size_t items = 8;
+
+    cl::sycl::queue q;
+    q.submit([&](cl::sycl::handler& h) {
+      auto acc = pMap.get_access<sycl_acc_rw>(viewPtr, h);
+      h.parallel_for<class vec_view_kernel>(
+          cl::sycl::range<1>(items), [=](cl::sycl::id<1> id) {
+            auto view =
+                cl::sycl::codeplay::get_device_vec_view<float, 4>(acc, offset,
+                                                                  count);
+            view.for_each(id[0], items, [](float& x) { x *= 2.0f; },
+                          [](cl::sycl::float4& x) { x *= 2.0f; });
+          });
+    });
+
+    {
+      auto hostAcc = pMap.get_access<sycl_acc_rw, sycl_acc_host>(myPtr);
+      float* hostPtr = cl::sycl::codeplay::get_host_ptr_as<float>(hostAcc);
+      ASSERT_EQ(hostPtr[0], 0.0f);
+      for (size_t i = 1; i < size; i++) {
+        ASSERT_EQ(hostPtr[i], 2.0f * i);
+      }
+    }
+    SYCLfree(myPtr, pMap);
+    ASSERT_EQ(pMap.count(), 0u);
+  }
+}
@@ -131,21 +131,28 @@ int main(int argc, char* argv[]) {
 
   dim3 blockSize, gridSize;
 
-  // Number of threads in each thread block
-  blockSize = dim3(256, 1, 1);
+  using vecAdd_t = cl::sycl::codeplay::CudaCommandGroup<
+      ___CudaConverterFunctor___vecAdd<double*, double*, double*, int>>;
+
+  // Number of threads in each thread block, chosen for the device instead of
+  // the original blockSize = dim3(256, 1, 1). Each block uses one double of
+  // shared memory per thread.
+  auto occupancy =
+      cl::sycl::codeplay::max_potential_block_size_variable_local_mem<
+          vecAdd_t>(deviceQueue,
+                    [](int block) { return block * sizeof(double); });
+  blockSize = dim3(occupancy.block_size, 1, 1);
 
   // Number of thread blocks in grid
-  gridSize = dim3((int)ceil((float)n / blockSize.x), 1, 1);
+  gridSize = dim3(occupancy.get_grid_size(n), 1, 1);
   // Shared memory size in byte for SYCL
   // Original :  shared memory size in byte
-  int sharedmem = blockSize.x * sizeof(int);
+  int sharedmem = blockSize.x * sizeof(double);
   using data_type = cl::sycl::codeplay::acc_t<uint8_t>;
   // Execute the kernel
   // Original: vecAdd<<<gridSize, blockSize, sharedmem>>>(d_a, d_b, d_c, n);
   deviceQueue.submit(
-      cl::sycl::codeplay::CudaCommandGroup<
-          ___CudaConverterFunctor___vecAdd<double*, double*, double*, int>>(
-          gridSize, blockSize, sharedmem, d_a, d_b, d_c, n));
+      vecAdd_t(gridSize, blockSize, sharedmem, d_a, d_b, d_c, n));
 
   // Copy array back to host
   // Original: cudaMemcpy( h_c, d_c, bytes, cudaMemcpyDeviceToHost );
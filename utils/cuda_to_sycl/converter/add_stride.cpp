@@ -120,8 +120,9 @@ int main(int argc, char* argv[]) {
 
   // Execute the kernel
   // Original: vecAdd<<<numBlocks, blockSize>>>(n, d_a, d_b);
+  // The grid is one-dimensional, so a 1D nd_range is launched
   deviceQueue.submit(cl::sycl::codeplay::CudaCommandGroup<
-                     ___CudaConverterFunctor___add<int, float*, float*>>(
+                     ___CudaConverterFunctor___add<int, float*, float*>, 1>(
       numBlocks, blockSize, n, d_a, d_b));
 
   // Copy array back to host
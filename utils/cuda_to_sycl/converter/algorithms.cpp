@@ -0,0 +1,133 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2018 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  algorithms.cpp
+ *
+ *  Description:
+ *   Runs the converter parallel algorithms on device allocations and checks
+ *   their results against the standard library.
+ *
+ **************************************************************************/
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+// Header added by the source to source tool
+#include "algorithms.hpp"
+
+namespace codeplay = cl::sycl::codeplay;
+
+struct square {
+  int operator()(int x) const { return x * x; }
+};
+
+struct is_odd {
+  bool operator()(int x) const { return (x % 2) != 0; }
+};
+
+template <typename T>
+T* device_malloc(size_t count) {
+  return static_cast<T*>(codeplay::SYCLmalloc(
+      count * sizeof(T), codeplay::get_global_pointer_mapper()));
+}
+
+template <typename T>
+void to_device(cl::sycl::queue& q, const std::vector<T>& src, T* dst) {
+  codeplay::cuda_copy_conversion<codeplay::Kind::HostToDevice>(
+      q, src.data(), dst, src.size() * sizeof(T), true);
+}
+
+template <typename T>
+std::vector<T> to_host(cl::sycl::queue& q, const T* src, size_t count) {
+  std::vector<T> dst(count);
+  codeplay::cuda_copy_conversion<codeplay::Kind::DeviceToHost>(
+      q, src, dst.data(), count * sizeof(T), false);
+  return dst;
+}
+
+bool report(const char* name, bool passed) {
+  std::cout << name << ": " << (passed ? "passed" : "FAILED") << std::endl;
+  return passed;
+}
+
+int main(int argc, char* argv[]) {
+  const size_t n = 100000;
+  cl::sycl::queue q((cl::sycl::default_selector()));
+
+  std::vector<int> h_in(n);
+  for (size_t i = 0; i < n; i++) {
+    h_in[i] = static_cast<int>((i * 7919) % 1000) - 500;
+  }
+
+  int* d_in = device_malloc<int>(n);
+  int* d_out = device_malloc<int>(n);
+  unsigned int* d_count = device_malloc<unsigned int>(1);
+  to_device(q, h_in, d_in);
+
+  bool passed = true;
+
+  codeplay::sycl_reduce(q, d_in, n, d_out, 10);
+  int sum = to_host(q, d_out, 1)[0];
+  passed &= report("reduce",
+                   sum == std::accumulate(h_in.begin(), h_in.end(), 10));
+
+  codeplay::sycl_inclusive_scan(q, d_in, n, d_out);
+  std::vector<int> expected(n);
+  std::partial_sum(h_in.begin(), h_in.end(), expected.begin());
+  passed &= report("inclusive_scan", to_host(q, d_out, n) == expected);
+
+  // In place, the input and the output share a single accessor
+  codeplay::sycl_inclusive_scan(q, d_out, n, d_out);
+  std::partial_sum(expected.begin(), expected.end(), expected.begin());
+  passed &= report("inclusive_scan in place", to_host(q, d_out, n) == expected);
+
+  codeplay::sycl_transform(q, d_in, n, d_out, square());
+  std::transform(h_in.begin(), h_in.end(), expected.begin(), square());
+  passed &= report("transform", to_host(q, d_out, n) == expected);
+
+  codeplay::sycl_copy_if(q, d_in, n, d_out, d_count, is_odd());
+  expected.erase(
+      std::copy_if(h_in.begin(), h_in.end(), expected.begin(), is_odd()),
+      expected.end());
+  unsigned int count = to_host(q, d_count, 1)[0];
+  passed &= report("copy_if", count == expected.size() &&
+                                  to_host(q, d_out, count) == expected);
+
+  // The output only needs room for the selected elements
+  int* d_selected = device_malloc<int>(expected.size());
+  codeplay::sycl_copy_if(q, d_in, n, d_selected, d_count, is_odd());
+  count = to_host(q, d_count, 1)[0];
+  passed &= report("copy_if to a fitting output",
+                   count == expected.size() &&
+                       to_host(q, d_selected, count) == expected);
+  codeplay::SYCLfree(d_selected, codeplay::get_global_pointer_mapper());
+
+  codeplay::sycl_sort(q, d_in, n);
+  expected = h_in;
+  std::sort(expected.begin(), expected.end());
+  passed &= report("sort", to_host(q, d_in, n) == expected);
+
+  codeplay::SYCLfree(d_in, codeplay::get_global_pointer_mapper());
+  codeplay::SYCLfree(d_out, codeplay::get_global_pointer_mapper());
+  codeplay::SYCLfree(d_count, codeplay::get_global_pointer_mapper());
+
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,642 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2018 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  algorithms.hpp
+ *
+ *  Description:
+ *    Thrust-like parallel algorithms over virtual pointers: reduce,
+ *    inclusive_scan, sort, transform and copy_if.
+ *
+ **************************************************************************/
+#ifndef COMPATIBILITY_ALGORITHMS_HPP
+#define COMPATIBILITY_ALGORITHMS_HPP
+
+#include "compatibility_definitions.hpp"
+
+namespace cl {
+namespace sycl {
+namespace codeplay {
+
+/* All the algorithms take virtual pointers and element counts, submit their
+ * kernels to the given queue or stream without waiting for them, and return
+ * the event of the last kernel.
+ * The operations are function objects such as std::plus<T>. Their types
+ * become part of the kernel names, so they must be declared at namespace
+ * scope rather than be lambdas. Temporary buffers are created without host
+ * memory, so releasing them does not wait for the kernels using them.
+ * As for the device to device copies, an allocation is never accessed twice
+ * in the same command group: an output that is exactly the input is accessed
+ * once in read_write mode, and an input sharing its allocation with an output
+ * otherwise is first copied to a temporary buffer.
+ */
+namespace detail {
+
+using read_acc_t = cl::sycl::accessor<uint8_t, 1, access::mode::read,
+                                      access::target::global_buffer>;
+using write_acc_t = cl::sycl::accessor<uint8_t, 1, access::mode::discard_write,
+                                       access::target::global_buffer>;
+using rw_acc_t = cl::sycl::accessor<uint8_t, 1, access::mode::read_write,
+                                    access::target::global_buffer>;
+template <typename T>
+using scratch_acc_t =
+    cl::sycl::accessor<T, 1, access::mode::read_write, access::target::local>;
+
+template <typename T, typename acc_t>
+T* as_ptr(const acc_t& acc) {
+  return reinterpret_cast<T*>(acc.get_pointer().get());
+}
+
+inline size_t next_pow2(size_t n) {
+  size_t p = 1;
+  while (p < n) {
+    p <<= 1;
+  }
+  return p;
+}
+
+// Largest power of two work-group size up to 256 supported by the device
+template <typename queue_t>
+size_t get_work_group_size(queue_t& q) {
+  size_t max_size = get_queue_device(q)
+                        .template get_info<info::device::max_work_group_size>();
+  size_t wg = 256;
+  while (wg > max_size) {
+    wg >>= 1;
+  }
+  return wg;
+}
+
+inline buffer_range make_temporary(size_t size) {
+  return buffer_range(PointerMapper::buffer_t(cl::sycl::range<1>{size}), 0,
+                      size);
+}
+
+// Copies the range to a new temporary buffer, so that it can be read in a
+// command group that writes to another range of its allocation
+template <typename queue_t>
+buffer_range copy_to_temporary(queue_t& q, buffer_range src) {
+  buffer_range tmp = make_temporary(src.size);
+  q.submit([&](cl::sycl::handler& h) {
+    auto src_acc = src.get_access<access::mode::read>(h);
+    auto tmp_acc = tmp.get_access<access::mode::discard_write>(h);
+    h.copy(src_acc, tmp_acc);
+  });
+  return tmp;
+}
+
+/* Tree reduction of the work-group values in scratch, valid for any
+ * work-group size. The result is left in scratch[0]. */
+template <typename T, typename Op>
+void reduce_work_group(cl::sycl::nd_item<1> it, scratch_acc_t<T> scratch,
+                       Op op) {
+  size_t lid = it.get_local_id(0);
+  size_t wg = it.get_local_range(0);
+  for (size_t s = next_pow2(wg) / 2; s > 0; s /= 2) {
+    it.barrier(access::fence_space::local_space);
+    if (lid < s && lid + s < wg) {
+      scratch[lid] = op(scratch[lid], scratch[lid + s]);
+    }
+  }
+}
+
+/* Each work-item folds the elements of the input at a stride of the global
+ * range, and each work-group writes the reduction of its work-items. Every
+ * work-item is given at least one element. With has_init, the value is
+ * combined with the result. */
+template <typename T, typename Op>
+class reduce_kernel {
+ public:
+  reduce_kernel(read_acc_t in, write_acc_t out, scratch_acc_t<T> scratch,
+                size_t n, Op op, T init, bool has_init)
+      : m_in(in),
+        m_out(out),
+        m_scratch(scratch),
+        m_n(n),
+        m_op(op),
+        m_init(init),
+        m_has_init(has_init) {}
+
+  void operator()(cl::sycl::nd_item<1> it) const {
+    const T* in = as_ptr<const T>(m_in);
+    size_t gid = it.get_global_id(0);
+    size_t stride = it.get_global_range(0);
+    T acc = in[gid];
+    for (size_t i = gid + stride; i < m_n; i += stride) {
+      acc = m_op(acc, in[i]);
+    }
+    m_scratch[it.get_local_id(0)] = acc;
+    reduce_work_group(it, m_scratch, m_op);
+    if (it.get_local_id(0) == 0) {
+      T res = m_has_init ? m_op(m_init, m_scratch[0]) : m_scratch[0];
+      as_ptr<T>(m_out)[it.get_group(0)] = res;
+    }
+  }
+
+ private:
+  read_acc_t m_in;
+  write_acc_t m_out;
+  scratch_acc_t<T> m_scratch;
+  size_t m_n;
+  Op m_op;
+  T m_init;
+  bool m_has_init;
+};
+
+/* Inclusive scan of the tile of each work-group, writing the total of each
+ * tile to sums when there is more than one. In place scans pass the output
+ * accessor as the input. */
+template <typename T, typename Op, typename in_acc_t = read_acc_t>
+class scan_tile_kernel {
+ public:
+  scan_tile_kernel(in_acc_t in, rw_acc_t out, rw_acc_t sums,
+                   scratch_acc_t<T> scratch, size_t n, Op op, bool has_sums)
+      : m_in(in),
+        m_out(out),
+        m_sums(sums),
+        m_scratch(scratch),
+        m_n(n),
+        m_op(op),
+        m_has_sums(has_sums) {}
+
+  void operator()(cl::sycl::nd_item<1> it) const {
+    size_t gid = it.get_global_id(0);
+    size_t lid = it.get_local_id(0);
+    size_t wg = it.get_local_range(0);
+    m_scratch[lid] = (gid < m_n) ? as_ptr<const T>(m_in)[gid] : T();
+    for (size_t offset = 1; offset < wg; offset *= 2) {
+      it.barrier(access::fence_space::local_space);
+      T value = m_scratch[lid];
+      if (lid >= offset) {
+        value = m_op(m_scratch[lid - offset], value);
+      }
+      it.barrier(access::fence_space::local_space);
+      m_scratch[lid] = value;
+    }
+    if (gid < m_n) {
+      as_ptr<T>(m_out)[gid] = m_scratch[lid];
+    }
+    // The last valid element of the tile holds its total
+    size_t last = std::min(m_n, (it.get_group(0) + 1) * wg) - 1;
+    if (m_has_sums && gid == last) {
+      as_ptr<T>(m_sums)[it.get_group(0)] = m_scratch[lid];
+    }
+  }
+
+ private:
+  in_acc_t m_in;
+  rw_acc_t m_out;
+  rw_acc_t m_sums;
+  scratch_acc_t<T> m_scratch;
+  size_t m_n;
+  Op m_op;
+  bool m_has_sums;
+};
+
+// Combines every tile after the first with the scanned total of the previous
+// tiles
+template <typename T, typename Op>
+class scan_add_kernel {
+ public:
+  scan_add_kernel(rw_acc_t out, read_acc_t sums, size_t n, size_t tile, Op op)
+      : m_out(out), m_sums(sums), m_n(n), m_tile(tile), m_op(op) {}
+
+  void operator()(cl::sycl::item<1> it) const {
+    size_t i = it.get_id(0) + m_tile;
+    if (i < m_n) {
+      T* out = as_ptr<T>(m_out);
+      out[i] = m_op(as_ptr<const T>(m_sums)[i / m_tile - 1], out[i]);
+    }
+  }
+
+ private:
+  rw_acc_t m_out;
+  read_acc_t m_sums;
+  size_t m_n;
+  size_t m_tile;
+  Op m_op;
+};
+
+template <typename T, typename queue_t, typename Op>
+cl::sycl::event inclusive_scan_range(queue_t& q, buffer_range in,
+                                     buffer_range out, size_t n, Op op,
+                                     size_t wg) {
+  size_t groups = (n + wg - 1) / wg;
+  bool has_sums = groups > 1;
+  // Every work-item reads its element before writing it, so a scan onto its
+  // own input only needs the output accessor
+  bool in_place = in.same_allocation(out) && in.offset == out.offset;
+  if (!in_place && in.same_allocation(out)) {
+    in = copy_to_temporary(q, in);
+  }
+  buffer_range sums = make_temporary(std::max<size_t>(groups, 1) * sizeof(T));
+  auto event = q.submit([&](cl::sycl::handler& h) {
+    auto out_acc = out.get_access<access::mode::read_write>(h);
+    auto sums_acc = sums.get_access<access::mode::read_write>(h);
+    scratch_acc_t<T> scratch(cl::sycl::range<1>{wg}, h);
+    cl::sycl::nd_range<1> range(cl::sycl::range<1>{groups * wg},
+                                cl::sycl::range<1>{wg});
+    if (in_place) {
+      h.parallel_for(range, scan_tile_kernel<T, Op, rw_acc_t>(
+                                out_acc, out_acc, sums_acc, scratch, n, op,
+                                has_sums));
+    } else {
+      auto in_acc = in.get_access<access::mode::read>(h);
+      h.parallel_for(range, scan_tile_kernel<T, Op>(in_acc, out_acc, sums_acc,
+                                                    scratch, n, op, has_sums));
+    }
+  });
+  if (!has_sums) {
+    return event;
+  }
+  inclusive_scan_range<T>(q, sums, sums, groups, op, wg);
+  return q.submit([&](cl::sycl::handler& h) {
+    auto out_acc = out.get_access<access::mode::read_write>(h);
+    auto sums_acc = sums.get_access<access::mode::read>(h);
+    h.parallel_for(cl::sycl::range<1>{n - wg},
+                   scan_add_kernel<T, Op>(out_acc, sums_acc, n, wg, op));
+  });
+}
+
+/* One compare-and-swap step of a bitonic sorting network in which every
+ * comparison leaves the smaller element at the lower index. The first step
+ * of each stage compares mirrored elements of blocks of size elements, the
+ * following ones elements j apart. Elements past n behave as larger than
+ * any other, so they never need to be swapped. */
+inline bool sort_partner(size_t i, size_t size, size_t j, bool first, size_t n,
+                  size_t& partner) {
+  partner = first ? (i ^ (size - 1)) : (i ^ j);
+  return partner > i && partner < n;
+}
+
+template <typename T, typename Comp>
+class sort_step_kernel {
+ public:
+  sort_step_kernel(rw_acc_t data, size_t n, size_t size, size_t j, bool first,
+                   Comp comp)
+      : m_data(data),
+        m_n(n),
+        m_size(size),
+        m_j(j),
+        m_first(first),
+        m_comp(comp) {}
+
+  void operator()(cl::sycl::item<1> it) const {
+    size_t i = it.get_id(0);
+    size_t partner;
+    if (sort_partner(i, m_size, m_j, m_first, m_n, partner)) {
+      T* data = as_ptr<T>(m_data);
+      T a = data[i];
+      T b = data[partner];
+      if (m_comp(b, a)) {
+        data[i] = b;
+        data[partner] = a;
+      }
+    }
+  }
+
+ private:
+  rw_acc_t m_data;
+  size_t m_n;
+  size_t m_size;
+  size_t m_j;
+  bool m_first;
+  Comp m_comp;
+};
+
+/* Runs in local memory the steps of the network whose elements are all in
+ * the tile of the work-group: every stage up to the tile size when size is
+ * 0, or the steps j < tile size of the stage of the given size. */
+template <typename T, typename Comp>
+class sort_tile_kernel {
+ public:
+  sort_tile_kernel(rw_acc_t data, scratch_acc_t<T> scratch, size_t n,
+                   size_t size, Comp comp)
+      : m_data(data), m_scratch(scratch), m_n(n), m_size(size), m_comp(comp) {}
+
+  void operator()(cl::sycl::nd_item<1> it) const {
+    T* data = as_ptr<T>(m_data);
+    size_t gid = it.get_global_id(0);
+    size_t lid = it.get_local_id(0);
+    size_t wg = it.get_local_range(0);
+    size_t base = gid - lid;
+    if (gid < m_n) {
+      m_scratch[lid] = data[gid];
+    }
+    if (m_size == 0) {
+      for (size_t size = 2; size <= wg; size *= 2) {
+        step(it, base, size, size / 2, true);
+        for (size_t j = size / 4; j > 0; j /= 2) {
+          step(it, base, size, j, false);
+        }
+      }
+    } else {
+      for (size_t j = wg / 2; j > 0; j /= 2) {
+        step(it, base, m_size, j, false);
+      }
+    }
+    it.barrier(access::fence_space::local_space);
+    if (gid < m_n) {
+      data[gid] = m_scratch[lid];
+    }
+  }
+
+ private:
+  void step(cl::sycl::nd_item<1> it, size_t base, size_t size, size_t j,
+            bool first) const {
+    it.barrier(access::fence_space::local_space);
+    size_t i = it.get_global_id(0);
+    size_t partner;
+    if (sort_partner(i, size, j, first, m_n, partner)) {
+      T a = m_scratch[i - base];
+      T b = m_scratch[partner - base];
+      if (m_comp(b, a)) {
+        m_scratch[i - base] = b;
+        m_scratch[partner - base] = a;
+      }
+    }
+  }
+
+  rw_acc_t m_data;
+  scratch_acc_t<T> m_scratch;
+  size_t m_n;
+  size_t m_size;
+  Comp m_comp;
+};
+
+// Writes a single value
+template <typename T>
+class store_kernel {
+ public:
+  store_kernel(write_acc_t out, T value) : m_out(out), m_value(value) {}
+
+  void operator()() const { as_ptr<T>(m_out)[0] = m_value; }
+
+ private:
+  write_acc_t m_out;
+  T m_value;
+};
+
+// In place transforms pass the output accessor as the input
+template <typename T, typename U, typename Op, typename in_acc_t = read_acc_t>
+class transform_kernel {
+ public:
+  transform_kernel(in_acc_t in, rw_acc_t out, Op op)
+      : m_in(in), m_out(out), m_op(op) {}
+
+  void operator()(cl::sycl::item<1> it) const {
+    size_t i = it.get_id(0);
+    as_ptr<U>(m_out)[i] = m_op(as_ptr<const T>(m_in)[i]);
+  }
+
+ private:
+  in_acc_t m_in;
+  rw_acc_t m_out;
+  Op m_op;
+};
+
+template <typename T, typename Pred>
+class copy_if_flag_kernel {
+ public:
+  copy_if_flag_kernel(read_acc_t in, write_acc_t flags, Pred pred)
+      : m_in(in), m_flags(flags), m_pred(pred) {}
+
+  void operator()(cl::sycl::item<1> it) const {
+    size_t i = it.get_id(0);
+    as_ptr<unsigned int>(m_flags)[i] =
+        m_pred(as_ptr<const T>(m_in)[i]) ? 1u : 0u;
+  }
+
+ private:
+  read_acc_t m_in;
+  write_acc_t m_flags;
+  Pred m_pred;
+};
+
+// Moves the selected elements to the positions given by the scanned flags
+template <typename T>
+class copy_if_scatter_kernel {
+ public:
+  copy_if_scatter_kernel(read_acc_t in, read_acc_t positions, rw_acc_t out)
+      : m_in(in), m_positions(positions), m_out(out) {}
+
+  void operator()(cl::sycl::item<1> it) const {
+    size_t i = it.get_id(0);
+    const unsigned int* positions = as_ptr<const unsigned int>(m_positions);
+    unsigned int before = (i == 0) ? 0u : positions[i - 1];
+    if (positions[i] != before) {
+      as_ptr<T>(m_out)[before] = as_ptr<const T>(m_in)[i];
+    }
+  }
+
+ private:
+  read_acc_t m_in;
+  read_acc_t m_positions;
+  rw_acc_t m_out;
+};
+
+}  // namespace detail
+
+/** sycl_reduce.
+ * @brief Equivalent of thrust::reduce: writes op(init, in[0], ..., in[n-1])
+ * to out[0]. The operation must be associative and commutative.
+ */
+template <typename queue_t, typename T, typename Op = std::plus<T>>
+cl::sycl::event sycl_reduce(queue_t& q, const T* in, size_t n, T* out,
+                            T init = T(), Op op = Op()) {
+  buffer_range out_range(out, sizeof(T));
+  if (n == 0) {
+    return q.submit([&](cl::sycl::handler& h) {
+      auto out_acc = out_range.get_access<access::mode::discard_write>(h);
+      h.single_task(detail::store_kernel<T>(out_acc, init));
+    });
+  }
+  size_t wg = std::min(detail::get_work_group_size(q), n);
+  // Every work-item must get at least one element, and the partial results
+  // must fit in a single work-group
+  size_t groups = std::max<size_t>(1, std::min(wg, n / wg));
+  buffer_range in_range(in, n * sizeof(T));
+  buffer_range partials = detail::make_temporary(groups * sizeof(T));
+  auto reduce = [&](buffer_range& src, buffer_range& dst, size_t count,
+                    size_t num_groups, size_t size, bool has_init) {
+    return q.submit([&](cl::sycl::handler& h) {
+      auto in_acc = src.get_access<access::mode::read>(h);
+      auto out_acc = dst.get_access<access::mode::discard_write>(h);
+      detail::scratch_acc_t<T> scratch(cl::sycl::range<1>{size}, h);
+      h.parallel_for(
+          cl::sycl::nd_range<1>(cl::sycl::range<1>{num_groups * size},
+                                cl::sycl::range<1>{size}),
+          detail::reduce_kernel<T, Op>(in_acc, out_acc, scratch, count, op,
+                                       init, has_init));
+    });
+  };
+  reduce(in_range, partials, n, groups, wg, false);
+  return reduce(partials, out_range, groups, 1, groups, true);
+}
+
+/** sycl_inclusive_scan.
+ * @brief Equivalent of thrust::inclusive_scan: out[i] = op(in[0], ...,
+ * in[i]). The output may be the input. The operation must be associative.
+ */
+template <typename queue_t, typename T, typename Op = std::plus<T>>
+cl::sycl::event sycl_inclusive_scan(queue_t& q, const T* in, size_t n,
+                                    T* out, Op op = Op()) {
+  if (n == 0) {
+    return cl::sycl::event{};
+  }
+  return detail::inclusive_scan_range<T>(
+      q, buffer_range(in, n * sizeof(T)), buffer_range(out, n * sizeof(T)), n,
+      op, detail::get_work_group_size(q));
+}
+
+/** sycl_sort.
+ * @brief Equivalent of thrust::sort: sorts the n elements in place with a
+ * bitonic sorting network, running the steps that fit in a work-group in
+ * local memory. The sort is not stable.
+ */
+template <typename queue_t, typename T, typename Comp = std::less<T>>
+cl::sycl::event sycl_sort(queue_t& q, T* data, size_t n, Comp comp = Comp()) {
+  if (n < 2) {
+    return cl::sycl::event{};
+  }
+  buffer_range data_range(data, n * sizeof(T));
+  size_t padded = detail::next_pow2(n);
+  size_t wg = std::min(detail::get_work_group_size(q), padded);
+  auto tile = [&](size_t size) {
+    return q.submit([&](cl::sycl::handler& h) {
+      auto acc = data_range.get_access<access::mode::read_write>(h);
+      detail::scratch_acc_t<T> scratch(cl::sycl::range<1>{wg}, h);
+      h.parallel_for(cl::sycl::nd_range<1>(cl::sycl::range<1>{padded},
+                                           cl::sycl::range<1>{wg}),
+                     detail::sort_tile_kernel<T, Comp>(acc, scratch, n, size,
+                                                       comp));
+    });
+  };
+  auto step = [&](size_t size, size_t j, bool first) {
+    q.submit([&](cl::sycl::handler& h) {
+      auto acc = data_range.get_access<access::mode::read_write>(h);
+      h.parallel_for(
+          cl::sycl::range<1>{padded},
+          detail::sort_step_kernel<T, Comp>(acc, n, size, j, first, comp));
+    });
+  };
+  auto event = tile(0);
+  for (size_t size = 2 * wg; size <= padded; size *= 2) {
+    step(size, size / 2, true);
+    for (size_t j = size / 4; j >= wg; j /= 2) {
+      step(size, j, false);
+    }
+    event = tile(size);
+  }
+  return event;
+}
+
+/** sycl_transform.
+ * @brief Equivalent of thrust::transform: out[i] = op(in[i]). The output may
+ * be the input.
+ */
+template <typename queue_t, typename T, typename U, typename Op>
+cl::sycl::event sycl_transform(queue_t& q, const T* in, size_t n, U* out,
+                               Op op) {
+  if (n == 0) {
+    return cl::sycl::event{};
+  }
+  buffer_range in_range(in, n * sizeof(T));
+  buffer_range out_range(out, n * sizeof(U));
+  // Each element is read and written by the same work-item, so the output
+  // can be the input when the elements have the same size
+  bool in_place = in_range.same_allocation(out_range) &&
+                  in_range.offset == out_range.offset &&
+                  sizeof(T) == sizeof(U);
+  if (!in_place && in_range.same_allocation(out_range)) {
+    in_range = detail::copy_to_temporary(q, in_range);
+  }
+  return q.submit([&](cl::sycl::handler& h) {
+    auto out_acc = out_range.get_access<access::mode::read_write>(h);
+    if (in_place) {
+      h.parallel_for(cl::sycl::range<1>{n},
+                     detail::transform_kernel<T, U, Op, detail::rw_acc_t>(
+                         out_acc, out_acc, op));
+    } else {
+      auto in_acc = in_range.get_access<access::mode::read>(h);
+      h.parallel_for(cl::sycl::range<1>{n},
+                     detail::transform_kernel<T, U, Op>(in_acc, out_acc, op));
+    }
+  });
+}
+
+/** sycl_copy_if.
+ * @brief Equivalent of thrust::copy_if: copies the elements for which pred
+ * is true to out, keeping their order, and writes their number to count[0].
+ * As with Thrust, out only needs room for the selected elements: the output
+ * is accessed up to the end of its allocation or n elements, whichever comes
+ * first.
+ */
+template <typename queue_t, typename T, typename Pred>
+cl::sycl::event sycl_copy_if(queue_t& q, const T* in, size_t n, T* out,
+                             unsigned int* count, Pred pred) {
+  buffer_range count_range(count, sizeof(unsigned int));
+  if (n == 0) {
+    return q.submit([&](cl::sycl::handler& h) {
+      auto count_acc = count_range.get_access<access::mode::discard_write>(h);
+      h.single_task(detail::store_kernel<unsigned int>(count_acc, 0u));
+    });
+  }
+  buffer_range in_range(in, n * sizeof(T));
+  buffer_range out_range(out, n * sizeof(T));
+  out_range.size = std::min(out_range.size,
+                            out_range.buffer.get_count() - out_range.offset);
+  if (in_range.same_allocation(out_range)) {
+    in_range = detail::copy_to_temporary(q, in_range);
+  }
+  buffer_range positions = detail::make_temporary(n * sizeof(unsigned int));
+  q.submit([&](cl::sycl::handler& h) {
+    auto in_acc = in_range.get_access<access::mode::read>(h);
+    auto flags_acc = positions.get_access<access::mode::discard_write>(h);
+    h.parallel_for(
+        cl::sycl::range<1>{n},
+        detail::copy_if_flag_kernel<T, Pred>(in_acc, flags_acc, pred));
+  });
+  detail::inclusive_scan_range<unsigned int>(q, positions, positions, n,
+                                             std::plus<unsigned int>(),
+                                             detail::get_work_group_size(q));
+  q.submit([&](cl::sycl::handler& h) {
+    auto in_acc = in_range.get_access<access::mode::read>(h);
+    auto pos_acc = positions.get_access<access::mode::read>(h);
+    auto out_acc = out_range.get_access<access::mode::read_write>(h);
+    h.parallel_for(
+        cl::sycl::range<1>{n},
+        detail::copy_if_scatter_kernel<T>(in_acc, pos_acc, out_acc));
+  });
+  // The last scanned flag is the number of selected elements. It is copied
+  // in its own command group, so count may share an allocation with out.
+  buffer_range last(positions.buffer, (n - 1) * sizeof(unsigned int),
+                    sizeof(unsigned int));
+  return q.submit([&](cl::sycl::handler& h) {
+    auto last_acc = last.get_access<access::mode::read>(h);
+    auto count_acc = count_range.get_access<access::mode::discard_write>(h);
+    h.copy(last_acc, count_acc);
+  });
+}
+
+}  // namespace codeplay
+}  // namespace sycl
+}  // namespace cl
+
+#endif  // COMPATIBILITY_ALGORITHMS_HPP
@@ -0,0 +1,168 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2018 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  atomic_benchmark.cpp
+ *
+ *  Description:
+ *   Measures the throughput of the converter atomicAdd on int and float,
+ *   with every work-item updating the same counter (contended) or its own
+ *   counter (uncontended), and compares the int case with the same kernel
+ *   written directly in SYCL.
+ *
+ **************************************************************************/
+#include <chrono>
+#include <iostream>
+
+// Header added by the source to source tool
+#include "compatibility_definitions.hpp"
+
+// Generated class:: Kernel dispatch.
+// This signature must be variadic
+template <typename... Args>
+struct ___CudaConverterFunctor___accumulate
+    : public cl::sycl::codeplay::Generic_Kernel_Functor<
+          ___CudaConverterFunctor___accumulate<Args...>> {
+  using parent = cl::sycl::codeplay::Generic_Kernel_Functor<
+      ___CudaConverterFunctor___accumulate<Args...>>;
+  using parent::atomicAdd;
+  using parent::blockDim;
+  using parent::blockIdx;
+  using parent::gridDim;
+  using parent::threadIdx;
+
+  ___CudaConverterFunctor___accumulate(Args... args) : parent(args...) {}
+  // kernel executor
+  template <typename... params_t>
+  void __execute__(params_t... params) {
+    accumulate(params...);
+  }
+  // When mask is 0 every thread updates counters[0]
+  __global__ void accumulate(int n, int mask, int* counters) {
+    int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) atomicAdd(&counters[i & mask], 1);
+  }
+  __global__ void accumulate(int n, int mask, float* counters) {
+    int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) atomicAdd(&counters[i & mask], 1.0f);
+  }
+};
+
+class handwritten_accumulate;
+
+// Submits the given launch `iterations` times and returns the number of
+// atomic updates per nanosecond
+template <typename launch_t>
+double time_updates(cl::sycl::queue& q, int n, int iterations,
+                    launch_t launch) {
+  // Warm-up launch, which also builds the kernel
+  launch();
+  q.wait();
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    launch();
+  }
+  q.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+  return (static_cast<double>(n) * iterations) /
+         std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+  const int n = 1 << 20;
+  const int iterations = 20;
+  const int blockSize = 256;
+  const int numBlocks = (n + blockSize - 1) / blockSize;
+  // n is a power of two, so n - 1 gives one counter per work-item
+  const int contended = 0;
+  const int uncontended = n - 1;
+
+  cl::sycl::queue deviceQueue((cl::sycl::default_selector()));
+  auto& pMap = cl::sycl::codeplay::get_global_pointer_mapper();
+
+  int* d_i = static_cast<int*>(
+      cl::sycl::codeplay::SYCLmalloc(n * sizeof(int), pMap));
+  float* d_f = static_cast<float*>(
+      cl::sycl::codeplay::SYCLmalloc(n * sizeof(float), pMap));
+  cl::sycl::codeplay::sycl_memset(deviceQueue, d_i, 0, n * sizeof(int));
+  cl::sycl::codeplay::sycl_memset(deviceQueue, d_f, 0, n * sizeof(float));
+
+  using int_functor_t = ___CudaConverterFunctor___accumulate<int, int, int*>;
+  using float_functor_t =
+      ___CudaConverterFunctor___accumulate<int, int, float*>;
+
+  auto converter = [&](int mask, int* counters) {
+    return time_updates(deviceQueue, n, iterations, [&]() {
+      deviceQueue.submit(
+          cl::sycl::codeplay::CudaCommandGroup<int_functor_t, 1>(
+              numBlocks, blockSize, n, mask, counters));
+    });
+  };
+  auto converter_float = [&](int mask, float* counters) {
+    return time_updates(deviceQueue, n, iterations, [&]() {
+      deviceQueue.submit(
+          cl::sycl::codeplay::CudaCommandGroup<float_functor_t, 1>(
+              numBlocks, blockSize, n, mask, counters));
+    });
+  };
+  auto handwritten = [&](int mask, int* counters) {
+    return time_updates(deviceQueue, n, iterations, [&]() {
+      deviceQueue.submit([&](cl::sycl::handler& h) {
+        auto c = pMap.get_access<cl::sycl::access::mode::read_write>(counters,
+                                                                     h);
+        h.parallel_for<handwritten_accumulate>(
+            cl::sycl::nd_range<1>(cl::sycl::range<1>(numBlocks * blockSize),
+                                  cl::sycl::range<1>(blockSize)),
+            [=](cl::sycl::nd_item<1> it) {
+              int i = it.get_global_id(0);
+              auto pc = reinterpret_cast<int*>(c.get_pointer().get());
+              if (i < n) {
+#if COMPATIBILITY_SYCL_2020
+                cl::sycl::atomic_ref<
+                    int, cl::sycl::memory_order::relaxed,
+                    cl::sycl::memory_scope::device,
+                    cl::sycl::access::address_space::global_space>(
+                    pc[i & mask])
+                    .fetch_add(1);
+#else
+                cl::sycl::atomic<int>(
+                    cl::sycl::multi_ptr<
+                        int, cl::sycl::access::address_space::global_space>(
+                        &pc[i & mask]))
+                    .fetch_add(1);
+#endif
+              }
+            });
+      });
+    });
+  };
+
+  std::cout << "Updates per ns      contended  uncontended\n";
+  std::cout << "atomicAdd int:      " << converter(contended, d_i) << "  "
+            << converter(uncontended, d_i) << "\n";
+  std::cout << "Handwritten int:    " << handwritten(contended, d_i) << "  "
+            << handwritten(uncontended, d_i) << "\n";
+  std::cout << "atomicAdd float:    " << converter_float(contended, d_f)
+            << "  " << converter_float(uncontended, d_f) << "\n";
+
+  SYCLfree(d_i, pMap);
+  SYCLfree(d_f, pMap);
+
+  return 0;
+}
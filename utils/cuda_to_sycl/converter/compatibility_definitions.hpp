@@ -40,6 +40,37 @@
 #include <stl-tuple/STLTuple.hpp>
 #include <vptr/virtual_ptr.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* The SYCL 2020 path enables in-order queues, event dependencies in command
+ * groups and sub-group operations. */
+#if defined(SYCL_LANGUAGE_VERSION) && (SYCL_LANGUAGE_VERSION >= 202000)
+#define COMPATIBILITY_SYCL_2020 1
+#else
+#define COMPATIBILITY_SYCL_2020 0
+#endif
+
 #define __global__
 #define __device__
 
@@ -56,11 +87,332 @@ struct dim3 {
 namespace cl {
 namespace sycl {
 namespace codeplay {
+using vptr::PointerMapper;
+using vptr::SYCLfree;
+using vptr::SYCLmalloc;
+
 PointerMapper& get_global_pointer_mapper() {
   static PointerMapper globalMapper_s;
   return globalMapper_s;
 }
 
+/** stream_t.
+ * @brief Emulates a cudaStream_t on top of a SYCL queue.
+ * Commands submitted to the same stream execute in submission order, while
+ * commands on different streams are free to overlap. On the SYCL 2020 path
+ * the underlying queue is in-order and cross-stream dependencies are passed
+ * to the command group as events. Otherwise, the dependencies tracked by the
+ * accessors order the commands, and any event the stream has been asked to
+ * wait on is waited for on the host before the next submission.
+ */
+class stream_t {
+ public:
+  explicit stream_t(cl::sycl::queue q)
+      : m_queue(q),
+        m_last{},
+        m_pending{},
+#if !COMPATIBILITY_SYCL_2020
+        m_inflight{},
+#endif
+        m_submitted(false) {}
+
+  /**
+   * Submits the command group to the stream, after every command submitted
+   * before it and after every event registered with wait_event.
+   * @param cgf Command group functor
+   * @return The event of the submitted command group
+   */
+  template <typename cgf_t>
+  cl::sycl::event submit(cgf_t cgf) {
+#if COMPATIBILITY_SYCL_2020
+    std::vector<cl::sycl::event> deps;
+    deps.swap(m_pending);
+    m_last = m_queue.submit([&](cl::sycl::handler& h) {
+      h.depends_on(deps);
+      cgf(h);
+    });
+#else
+    for (auto& e : m_pending) {
+      e.wait();
+    }
+    m_pending.clear();
+    prune_inflight();
+    m_last = m_queue.submit(cgf);
+    m_inflight.push_back(m_last);
+#endif
+    m_submitted = true;
+    return m_last;
+  }
+
+  /**
+   * Equivalent of cudaStreamWaitEvent: commands submitted to this stream
+   * after the call will not start until the given event has completed.
+   */
+  void wait_event(cl::sycl::event e) { m_pending.push_back(e); }
+
+  /**
+   * Equivalent of cudaEventRecord: returns the event of the last command
+   * submitted to this stream. On the SYCL 2020 path the queue is in-order, so
+   * it completes once every command submitted so far has completed.
+   * Otherwise the last command only follows the earlier commands it shares
+   * buffers with, and the event says nothing about the others; call
+   * synchronize to wait for all of them.
+   */
+  cl::sycl::event record() const { return m_last; }
+
+  /**
+   * Like record, but the command_end of the returned event also marks the
+   * current point of the stream, so it can be used for profiling.
+   * On the SYCL 2020 path the in-order queue orders the marker: the last
+   * command is reused, and an empty kernel is only submitted when there is
+   * no command yet or events were registered with wait_event since the last
+   * one. Otherwise the queue may run commands out of order, so the commands
+   * submitted so far are waited for on the host, then an empty kernel is
+   * submitted and waited for as well. No command submitted later can start
+   * before it.
+   */
+  cl::sycl::event record_marker() {
+#if COMPATIBILITY_SYCL_2020
+    if (!m_submitted || !m_pending.empty()) {
+      submit_marker();
+    }
+#else
+    for (auto& e : m_inflight) {
+      e.wait();
+    }
+    m_inflight.clear();
+    submit_marker();
+    m_last.wait();
+    m_inflight.clear();
+#endif
+    return m_last;
+  }
+
+  /**
+   * Equivalent of cudaStreamSynchronize.
+   */
+  void synchronize() {
+#if COMPATIBILITY_SYCL_2020
+    m_last.wait();
+#else
+    m_queue.wait();
+    m_inflight.clear();
+#endif
+  }
+
+  cl::sycl::queue& get_queue() { return m_queue; }
+
+ private:
+  void submit_marker() {
+    submit([](cl::sycl::handler& h) {
+      h.single_task<class stream_marker_kernel>([]() {});
+    });
+  }
+
+#if !COMPATIBILITY_SYCL_2020
+  // Drops the commands that have already completed, so a stream that is
+  // never synchronized only keeps track of the ones still running
+  void prune_inflight() {
+    auto done = [](const cl::sycl::event& e) {
+      return e.get_info<cl::sycl::info::event::command_execution_status>() ==
+             cl::sycl::info::event_command_status::complete;
+    };
+    m_inflight.erase(
+        std::remove_if(m_inflight.begin(), m_inflight.end(), done),
+        m_inflight.end());
+  }
+#endif
+
+  cl::sycl::queue m_queue;
+  cl::sycl::event m_last;
+  std::vector<cl::sycl::event> m_pending;
+#if !COMPATIBILITY_SYCL_2020
+  // Commands submitted since the last marker or synchronization
+  std::vector<cl::sycl::event> m_inflight;
+#endif
+  // Whether any command has been submitted, i.e. whether m_last refers to a
+  // command. It is never reset, since on an in-order queue the last command
+  // marks the point of the stream for as long as nothing follows it.
+  bool m_submitted;
+};
+
+using cudaStream_t = stream_t*;
+
+/** event_t.
+ * @brief Equivalent of cudaEvent_t: a point of a stream whose device
+ * timestamp can be compared with other events of the same device.
+ * Timestamps are read from the command_end profiling information of the
+ * marker of stream_t::record_marker, so the stream must have been created
+ * from a queue with the enable_profiling property. Without the SYCL 2020
+ * in-order queues, recording an event waits on the host for the work
+ * submitted to the stream so far.
+ */
+class event_t {
+ public:
+  event_t() : m_event{}, m_recorded(false) {}
+
+  /**
+   * Equivalent of cudaEventRecord.
+   */
+  void record(stream_t& stream) {
+    if (!stream.get_queue()
+             .has_property<cl::sycl::property::queue::enable_profiling>()) {
+      throw std::invalid_argument(
+          "Events can only be recorded on streams with profiling enabled");
+    }
+    m_event = stream.record_marker();
+    m_recorded = true;
+  }
+
+  void record(cudaStream_t stream) { record(*stream); }
+
+  /**
+   * Equivalent of cudaEventSynchronize.
+   */
+  void synchronize() {
+    check_recorded();
+    m_event.wait();
+  }
+
+  /**
+   * Equivalent of cudaEventQuery: true if every command preceding the event
+   * has completed.
+   */
+  bool query() const {
+    check_recorded();
+    auto status =
+        m_event.get_info<cl::sycl::info::event::command_execution_status>();
+    return status == cl::sycl::info::event_command_status::complete;
+  }
+
+  /**
+   * Waits for the event and returns its device timestamp in nanoseconds.
+   */
+  uint64_t get_timestamp() {
+    synchronize();
+    return m_event.get_profiling_info<
+        cl::sycl::info::event_profiling::command_end>();
+  }
+
+  cl::sycl::event get_event() const { return m_event; }
+
+ private:
+  void check_recorded() const {
+    if (!m_recorded) {
+      throw std::runtime_error("The event has not been recorded");
+    }
+  }
+
+  cl::sycl::event m_event;
+  bool m_recorded;
+};
+
+using cudaEvent_t = event_t*;
+
+/**
+ * Equivalent of cudaEventElapsedTime: waits for both events and returns the
+ * time elapsed between them in milliseconds.
+ */
+inline float event_elapsed_time(event_t& start, event_t& end) {
+  auto t_start = start.get_timestamp();
+  auto t_end = end.get_timestamp();
+  return static_cast<float>(
+      (static_cast<double>(t_end) - static_cast<double>(t_start)) * 1e-6);
+}
+
+inline float event_elapsed_time(cudaEvent_t start, cudaEvent_t end) {
+  return event_elapsed_time(*start, *end);
+}
+
+/** stream_pool.
+ * @brief Owns a fixed pool of queues sharing the context and device of the
+ * given queue, and maps streams onto them in a round-robin fashion.
+ * Buffers used through the pool never migrate between contexts, so copies on
+ * one stream can overlap with kernels on another. Streams mapped onto the
+ * same queue share it: on the SYCL 2020 path that queue is in-order, so their
+ * commands are serialized with each other. Create the pool with at least as
+ * many queues as streams that must run concurrently.
+ */
+class stream_pool {
+ public:
+  stream_pool(const cl::sycl::queue& q, size_t n_queues = 4,
+              const cl::sycl::property_list& pList = {})
+      : m_queues{}, m_streams{} {
+    if (n_queues == 0) {
+      throw std::invalid_argument("A stream pool needs at least one queue");
+    }
+    for (size_t i = 0; i < n_queues; i++) {
+      m_queues.push_back(make_queue(q, pList));
+    }
+  }
+
+  /**
+   * Equivalent of cudaStreamCreate.
+   * The returned stream is valid until destroy_stream is called or the pool
+   * is destroyed. Once there are more streams than queues, the new stream
+   * shares a queue with an existing one.
+   */
+  cudaStream_t create_stream() {
+    auto& q = m_queues[m_streams.size() % m_queues.size()];
+    m_streams.emplace_back(new stream_t(q));
+    return m_streams.back().get();
+  }
+
+  /**
+   * Equivalent of cudaStreamDestroy. Waits for the work in the stream.
+   */
+  void destroy_stream(cudaStream_t stream) {
+    for (auto it = m_streams.begin(); it != m_streams.end(); ++it) {
+      if (it->get() == stream) {
+        stream->synchronize();
+        m_streams.erase(it);
+        return;
+      }
+    }
+    throw std::out_of_range("The stream does not belong to this pool");
+  }
+
+  /**
+   * Equivalent of cudaDeviceSynchronize.
+   */
+  void synchronize() {
+    for (auto& q : m_queues) {
+      q.wait();
+    }
+  }
+
+  size_t get_num_queues() const { return m_queues.size(); }
+
+ private:
+  static cl::sycl::queue make_queue(const cl::sycl::queue& q,
+                                    const cl::sycl::property_list& pList) {
+#if COMPATIBILITY_SYCL_2020
+    return cl::sycl::queue(q.get_context(), q.get_device(),
+                           merge_in_order(pList));
+#else
+    return cl::sycl::queue(q.get_context(), q.get_device(), pList);
+#endif
+  }
+
+#if COMPATIBILITY_SYCL_2020
+  /* SYCL offers no way to enumerate or extend a property_list, so the list
+   * is rebuilt from the queue properties the standard defines: in_order is
+   * always added and enable_profiling is kept when requested. Any other
+   * property, e.g. a vendor extension, is dropped. */
+  static cl::sycl::property_list merge_in_order(
+      const cl::sycl::property_list& pList) {
+    if (pList.has_property<cl::sycl::property::queue::enable_profiling>()) {
+      return {cl::sycl::property::queue::in_order{},
+              cl::sycl::property::queue::enable_profiling{}};
+    }
+    return {cl::sycl::property::queue::in_order{}};
+  }
+#endif
+
+  std::vector<cl::sycl::queue> m_queues;
+  std::vector<std::unique_ptr<stream_t>> m_streams;
+};
+
 /**
  * Memcpy Direction Configuration
  */
@@ -73,19 +425,516 @@ enum Kind : int {
                  values. Requires unified virtual addressing */
 };
 
+/**
+ * Whether the given pointer was issued by the global pointer mapper and lies
+ * inside a live allocation.
+ * @note Host pointers are assumed not to alias the virtual address range
+ * issued by the pointer mapper.
+ */
+inline bool is_device_pointer(const void* ptr) {
+  auto& pMap = get_global_pointer_mapper();
+  if (PointerMapper::is_nullptr(ptr) || pMap.count() == 0) {
+    return false;
+  }
+  try {
+    auto node = pMap.get_node(ptr);
+    auto offset = reinterpret_cast<PointerMapper::base_ptr_t>(ptr) -
+                  static_cast<PointerMapper::base_ptr_t>(node->first);
+    return !node->second.m_free && (offset < node->second.m_size);
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+}
+
+/**
+ * Whether two device pointers lie in the same allocation of the global
+ * pointer mapper. The buffers returned by the mapper cannot be compared for
+ * this, since a new buffer object is made for every request.
+ */
+inline bool is_same_allocation(const void* a, const void* b) {
+  auto& pMap = get_global_pointer_mapper();
+  return pMap.get_node(a)->first == pMap.get_node(b)->first;
+}
+
+/**
+ * Returns an accessor to the `size` bytes starting at the given virtual
+ * pointer, so only that range is transferred and tracked as a dependency.
+ */
+template <cl::sycl::access::mode access_mode>
+cl::sycl::accessor<uint8_t, 1, access_mode, access::target::global_buffer>
+get_range_access(const void* ptr, size_t size, cl::sycl::handler& h) {
+  auto& pMap = get_global_pointer_mapper();
+  auto buf = pMap.get_buffer(ptr);
+  return buf.template get_access<access_mode>(
+      h, cl::sycl::range<1>{size},
+      cl::sycl::id<1>{static_cast<size_t>(pMap.get_offset(ptr))});
+}
+
+/** buffer_range.
+ * @brief A byte range of a buffer, usually the range of a virtual pointer
+ * allocation resolved once so that accessors to it can be created without
+ * looking it up in the pointer mapper again.
+ */
+struct buffer_range {
+  buffer_range(const void* ptr, size_t size)
+      : buffer(get_global_pointer_mapper().get_buffer(ptr)),
+        offset(static_cast<size_t>(get_global_pointer_mapper().get_offset(
+            ptr))),
+        size(size),
+        allocation(get_global_pointer_mapper().get_node(ptr)->first) {}
+
+  buffer_range(PointerMapper::buffer_t buffer, size_t offset, size_t size)
+      : buffer(buffer), offset(offset), size(size), allocation(nullptr) {}
+
+  /**
+   * Whether both ranges lie in the same allocation. As for
+   * is_same_allocation, ranges of virtual pointers are compared through the
+   * base of their allocation, and only the other ranges through their
+   * buffer objects.
+   */
+  bool same_allocation(const buffer_range& other) const {
+    if (allocation || other.allocation) {
+      return allocation == other.allocation;
+    }
+    return buffer == other.buffer;
+  }
+
+  template <cl::sycl::access::mode access_mode>
+  cl::sycl::accessor<uint8_t, 1, access_mode, access::target::global_buffer>
+  get_access(cl::sycl::handler& h) {
+    return buffer.get_access<access_mode>(h, cl::sycl::range<1>{size},
+                                          cl::sycl::id<1>{offset});
+  }
+
+  PointerMapper::buffer_t buffer;
+  size_t offset;
+  size_t size;
+  // Base of the virtual pointer allocation, or null for other buffers
+  const void* allocation;
+};
+
+/**
+ * Returns the size of a page of host memory.
+ */
+inline size_t get_host_page_size() {
+#if defined(_WIN32)
+  return 4096;
+#else
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/**
+ * Allocates page-aligned host memory and tries to page-lock it.
+ * Page-locking is only attempted on POSIX systems and may fail when the
+ * locked memory limit is reached, in which case the memory is still usable
+ * but pageable.
+ * @param locked Set to whether the memory could be page-locked
+ * @throw std::bad_alloc if the memory cannot be allocated
+ */
+inline void* allocate_pinned(size_t size, bool& locked) {
+  void* ptr = nullptr;
+  auto page = get_host_page_size();
+  auto rounded = ((size + page - 1) / page) * page;
+#if defined(_WIN32)
+  ptr = _aligned_malloc(rounded, page);
+  locked = false;
+#else
+  if (posix_memalign(&ptr, page, rounded) != 0) {
+    ptr = nullptr;
+  }
+  locked = (ptr != nullptr) && (mlock(ptr, rounded) == 0);
+#endif
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+/**
+ * Releases memory obtained from allocate_pinned.
+ */
+inline void free_pinned(void* ptr, size_t size, bool locked) {
+#if defined(_WIN32)
+  (void)size;
+  (void)locked;
+  _aligned_free(ptr);
+#else
+  if (locked) {
+    munlock(ptr, size);
+  }
+  std::free(ptr);
+#endif
+}
+
+/** host_registry.
+ * @brief Keeps track of pinned host allocations (cudaMallocHost) and of
+ * registered host ranges (cudaHostRegister).
+ * Each range is wrapped in a `use_host_ptr` buffer, so that on CPU and
+ * integrated devices kernels can access it without copies through the
+ * virtual pointer returned by get_device_pointer.
+ * Asynchronous copies from pageable memory are staged through a reusable
+ * pool of pinned buffers, so the caller can reuse its memory as soon as the
+ * copy has been issued, as with cudaMemcpyAsync.
+ * @note Not thread-safe, in line with the pointer mapper.
+ */
+class host_registry {
+ public:
+  using buffer_t = cl::sycl::buffer<uint8_t, 1>;
+
+  host_registry() : m_entries{}, m_staging{} {}
+
+  host_registry(const host_registry&) = delete;
+
+  ~host_registry() {
+    for (auto& e : m_entries) {
+      wait_for_users(e.second);
+      e.second.m_buffer.reset();
+      if (e.second.m_owned) {
+        free_pinned(reinterpret_cast<void*>(e.first), e.second.m_size,
+                    e.second.m_locked);
+      }
+    }
+    for (auto& slot : m_staging) {
+      slot.m_buffer.reset();
+      free_pinned(slot.m_ptr, slot.m_size, slot.m_locked);
+    }
+  }
+
+  /**
+   * Equivalent of cudaMallocHost.
+   */
+  void* allocate(size_t size) {
+    if (size == 0) {
+      return nullptr;
+    }
+    bool locked = false;
+    auto ptr = allocate_pinned(size, locked);
+    add_entry(ptr, size, true, locked);
+    return ptr;
+  }
+
+  /**
+   * Equivalent of cudaFreeHost. Waits for any device work using the memory.
+   */
+  void deallocate(void* ptr) {
+    if (ptr == nullptr) {
+      return;
+    }
+    auto it = m_entries.find(reinterpret_cast<std::uintptr_t>(ptr));
+    if (it == m_entries.end() || !it->second.m_owned) {
+      throw std::out_of_range("The pointer was not allocated as host memory");
+    }
+    remove_entry(it);
+  }
+
+  /**
+   * Equivalent of cudaHostRegister.
+   */
+  void register_memory(void* ptr, size_t size) {
+    if (ptr == nullptr || size == 0) {
+      throw std::invalid_argument("Cannot register an empty host range");
+    }
+    bool locked = false;
+#if !defined(_WIN32)
+    locked = (mlock(ptr, size) == 0);
+#endif
+    add_entry(ptr, size, false, locked);
+  }
+
+  /**
+   * Equivalent of cudaHostUnregister.
+   */
+  void unregister_memory(void* ptr) {
+    auto it = m_entries.find(reinterpret_cast<std::uintptr_t>(ptr));
+    if (it == m_entries.end() || it->second.m_owned) {
+      throw std::out_of_range("The pointer was not registered");
+    }
+    remove_entry(it);
+  }
+
+  /**
+   * Whether the pointer lies inside a pinned or registered range.
+   */
+  bool is_pinned(const void* ptr) const { return lookup(ptr) != nullptr; }
+
+  /**
+   * Records a command that reads or writes the pinned memory at ptr directly
+   * rather than through its buffer, such as an asynchronous copy. The memory
+   * is not freed or unregistered until the command has completed. Does
+   * nothing if ptr is not pinned.
+   */
+  void add_user(const void* ptr, cl::sycl::event e) {
+    auto entry = lookup(ptr);
+    if (entry == nullptr) {
+      return;
+    }
+    auto& events = entry->m_events;
+    events.erase(std::remove_if(events.begin(), events.end(), is_complete),
+                 events.end());
+    events.push_back(e);
+  }
+
+  /**
+   * Equivalent of cudaHostGetDevicePointer.
+   * Returns a virtual pointer, usable as a kernel argument, that aliases the
+   * given host memory.
+   */
+  void* get_device_pointer(void* ptr) {
+    auto entry = lookup(ptr);
+    if (entry == nullptr) {
+      throw std::out_of_range("The pointer is not pinned host memory");
+    }
+    if (PointerMapper::is_nullptr(entry->m_device_ptr)) {
+      entry->m_device_ptr = static_cast<void*>(
+          get_global_pointer_mapper().add_pointer(*entry->m_buffer));
+    }
+    auto offset = reinterpret_cast<std::uintptr_t>(ptr) - entry->m_base;
+    return static_cast<uint8_t*>(entry->m_device_ptr) + offset;
+  }
+
+  /**
+   * Makes the device writes to the mapped memory visible on the host.
+   * Must be called before reading on the host memory written by a kernel
+   * through the pointer returned by get_device_pointer.
+   */
+  void synchronize(void* ptr) {
+    auto entry = lookup(ptr);
+    if (entry == nullptr) {
+      throw std::out_of_range("The pointer is not pinned host memory");
+    }
+    auto acc = entry->m_buffer->get_access<cl::sycl::access::mode::read>();
+    (void)acc;
+  }
+
+  /**
+   * Copies `size` bytes from `src` into a pinned staging buffer that is not
+   * in use by the device and returns it.
+   * The staging buffer is reused once the event set by the caller through
+   * set_staging_event has completed.
+   */
+  buffer_t& stage(const void* src, size_t size, size_t& slot_id) {
+    slot_id = m_staging.size();
+    for (size_t i = 0; i < m_staging.size(); i++) {
+      auto& slot = m_staging[i];
+      if (slot.m_size >= size && is_complete(slot.m_event)) {
+        slot_id = i;
+        break;
+      }
+    }
+    if (slot_id == m_staging.size()) {
+      // Round up so that the buffer can be reused by similar transfers
+      size_t slot_size = get_host_page_size();
+      while (slot_size < size) {
+        slot_size *= 2;
+      }
+      bool locked = false;
+      auto ptr = allocate_pinned(slot_size, locked);
+      m_staging.push_back(staging_slot_t{
+          ptr, slot_size, locked,
+          std::make_shared<buffer_t>(
+              static_cast<uint8_t*>(ptr), cl::sycl::range<1>{slot_size},
+              cl::sycl::property_list{
+                  cl::sycl::property::buffer::use_host_ptr{}}),
+          cl::sycl::event{}});
+      m_staging.back().m_buffer->set_final_data(nullptr);
+    }
+    auto& slot = m_staging[slot_id];
+    {
+      auto acc =
+          slot.m_buffer->get_access<cl::sycl::access::mode::discard_write>(
+              cl::sycl::range<1>{size});
+      std::memcpy(acc.get_pointer(), src, size);
+    }
+    return *slot.m_buffer;
+  }
+
+  void set_staging_event(size_t slot_id, cl::sycl::event e) {
+    m_staging[slot_id].m_event = e;
+  }
+
+ private:
+  struct entry_t {
+    std::uintptr_t m_base;
+    size_t m_size;
+    bool m_owned;
+    bool m_locked;
+    std::shared_ptr<buffer_t> m_buffer;
+    void* m_device_ptr;
+    // Commands using the memory directly, see add_user
+    std::vector<cl::sycl::event> m_events;
+  };
+
+  struct staging_slot_t {
+    void* m_ptr;
+    size_t m_size;
+    bool m_locked;
+    std::shared_ptr<buffer_t> m_buffer;
+    cl::sycl::event m_event;
+  };
+
+  static bool is_complete(const cl::sycl::event& e) {
+    return e.get_info<cl::sycl::info::event::command_execution_status>() ==
+           cl::sycl::info::event_command_status::complete;
+  }
+
+  void add_entry(void* ptr, size_t size, bool owned, bool locked) {
+    auto base = reinterpret_cast<std::uintptr_t>(ptr);
+    auto buf = std::make_shared<buffer_t>(
+        static_cast<uint8_t*>(ptr), cl::sycl::range<1>{size},
+        cl::sycl::property_list{cl::sycl::property::buffer::use_host_ptr{}});
+    m_entries.emplace(base,
+                      entry_t{base, size, owned, locked, buf, nullptr, {}});
+  }
+
+  /**
+   * Waits for every command using the memory of the entry. Kernels using it
+   * through the buffer are waited for with a host accessor, which also writes
+   * back their modifications. The pointer mapper may keep a copy of the
+   * buffer, so destroying ours is not enough.
+   */
+  static void wait_for_users(entry_t& e) {
+    {
+      auto acc = e.m_buffer->get_access<cl::sycl::access::mode::read_write>();
+      (void)acc;
+    }
+    for (auto& ev : e.m_events) {
+      ev.wait();
+    }
+    e.m_events.clear();
+  }
+
+  void remove_entry(std::map<std::uintptr_t, entry_t>::iterator it) {
+    auto& e = it->second;
+    wait_for_users(e);
+    if (!PointerMapper::is_nullptr(e.m_device_ptr)) {
+      SYCLfree(e.m_device_ptr, get_global_pointer_mapper());
+    }
+    e.m_buffer.reset();
+    if (e.m_owned) {
+      free_pinned(reinterpret_cast<void*>(e.m_base), e.m_size, e.m_locked);
+    }
+#if !defined(_WIN32)
+    else if (e.m_locked) {
+      munlock(reinterpret_cast<void*>(e.m_base), e.m_size);
+    }
+#endif
+    m_entries.erase(it);
+  }
+
+  entry_t* lookup(const void* ptr) const {
+    auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+    auto it = m_entries.upper_bound(addr);
+    if (it == m_entries.begin()) {
+      return nullptr;
+    }
+    --it;
+    if (addr - it->first >= it->second.m_size) {
+      return nullptr;
+    }
+    return const_cast<entry_t*>(&it->second);
+  }
+
+  std::map<std::uintptr_t, entry_t> m_entries;
+  std::vector<staging_slot_t> m_staging;
+};
+
+inline host_registry& get_global_host_registry() {
+  static host_registry globalHostRegistry_s;
+  return globalHostRegistry_s;
+}
+
+/**
+ * Malloc-like interface for pinned host memory (cudaMallocHost).
+ */
+inline void* SYCLmallocHost(size_t size) {
+  return get_global_host_registry().allocate(size);
+}
+
+/**
+ * Free-like interface for pinned host memory (cudaFreeHost).
+ */
+inline void SYCLfreeHost(void* ptr) {
+  get_global_host_registry().deallocate(ptr);
+}
+
+/**
+ * Page-locks an existing host range (cudaHostRegister).
+ */
+inline void SYCLhostRegister(void* ptr, size_t size) {
+  get_global_host_registry().register_memory(ptr, size);
+}
+
+/**
+ * Releases a range registered with SYCLhostRegister (cudaHostUnregister).
+ */
+inline void SYCLhostUnregister(void* ptr) {
+  get_global_host_registry().unregister_memory(ptr);
+}
+
+/**
+ * Returns a virtual pointer aliasing pinned host memory
+ * (cudaHostGetDevicePointer).
+ */
+inline void* SYCLhostGetDevicePointer(void* ptr) {
+  return get_global_host_registry().get_device_pointer(ptr);
+}
+
+template <typename queue_t, typename cgf_t>
+cl::sycl::event submit_copy(queue_t& dQ, cgf_t cgf, bool async) {
+  auto event = dQ.submit(cgf);
+  if (!async) {
+    event.wait();
+  }
+  return event;
+}
+
 template <typename T1, typename T2, Kind kind_t>
 struct copy_t;
 
+template <typename T1, typename T2>
+struct copy_t<T1, T2, cl::sycl::codeplay::Kind::HostToHost> {
+  template <typename queue_t>
+  static cl::sycl::event sycl_copy_conversion(queue_t&, T1* src, T2* dst,
+                                              size_t size, bool) {
+    std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), size);
+    return cl::sycl::event{};
+  }
+};
+
 template <typename T1, typename T2>
 struct copy_t<T1, T2, cl::sycl::codeplay::Kind::HostToDevice> {
-  static cl::sycl::event sycl_copy_conversion(cl::sycl::queue dQ, T1* src,
-                                              T2* dst, bool async) {
-    auto event = dQ.submit([&](cl::sycl::handler& h) {
-      auto acc_ = get_global_pointer_mapper().get_access(dst, h);
-      h.copy((uint8_t*)src, acc_);
-    });
-    if (!async) {
-      event.wait();
+  template <typename queue_t>
+  static cl::sycl::event sycl_copy_conversion(queue_t& dQ, T1* src, T2* dst,
+                                              size_t size, bool async) {
+    auto& registry = get_global_host_registry();
+    if (async && !registry.is_pinned(src)) {
+      // Pageable memory can be reused by the caller as soon as the call
+      // returns, so it is staged in pinned memory first.
+      size_t slot_id;
+      host_registry::buffer_t& staging = registry.stage(src, size, slot_id);
+      auto event = dQ.submit([&](cl::sycl::handler& h) {
+        auto acc_src_ = staging.get_access<cl::sycl::access::mode::read>(
+            h, cl::sycl::range<1>{size});
+        auto acc_ =
+            get_range_access<cl::sycl::access::mode::discard_write>(dst, size,
+                                                                    h);
+        h.copy(acc_src_, acc_);
+      });
+      registry.set_staging_event(slot_id, event);
+      return event;
+    }
+    auto event = submit_copy(dQ,
+                             [&](cl::sycl::handler& h) {
+                               auto acc_ = get_range_access<
+                                   cl::sycl::access::mode::discard_write>(
+                                   dst, size, h);
+                               h.copy((const uint8_t*)src, acc_);
+                             },
+                             async);
+    if (async) {
+      // The copy reads the pinned memory until the event completes
+      registry.add_user(src, event);
     }
     return event;
   }
@@ -93,81 +942,1126 @@ struct copy_t<T1, T2, cl::sycl::codeplay::Kind::HostToDevice> {
 
 template <typename T1, typename T2>
 struct copy_t<T1, T2, cl::sycl::codeplay::Kind::DeviceToHost> {
-  static cl::sycl::event sycl_copy_conversion(cl::sycl::queue dQ, T1* src,
-                                              T2* dst, bool async) {
-    auto event = dQ.submit([&](cl::sycl::handler& h) {
-      auto acc_ = get_global_pointer_mapper().get_access(src, h);
-      h.copy(acc_, (uint8_t*)dst);
-    });
-    if (!async) {
-      event.wait();
+  template <typename queue_t>
+  static cl::sycl::event sycl_copy_conversion(queue_t& dQ, T1* src, T2* dst,
+                                              size_t size, bool async) {
+    auto event = submit_copy(dQ,
+                             [&](cl::sycl::handler& h) {
+                               auto acc_ = get_range_access<
+                                   cl::sycl::access::mode::read>(src, size, h);
+                               h.copy(acc_, (uint8_t*)dst);
+                             },
+                             async);
+    if (async) {
+      // The copy may write the pinned memory until the event completes
+      get_global_host_registry().add_user(dst, event);
     }
     return event;
   }
 };
 
-/** cuda_copy_conversion.
- * @brief Following the same API ordering as cudaMemCpy , converts the
- * direct memcpy into a SYCL copy operation, matching directionality.
- *
- * @todo Pointer offsets not implemented.
- * @todo Select correct directionality and trigger the right access mode.
- * @note Type dispatch mechanism can be used to implement the selection of the
- * appropriate copy functor.
- *
- * @param output Pointer to the destination
+template <typename T1, typename T2>
+struct copy_t<T1, T2, cl::sycl::codeplay::Kind::DeviceToDevice> {
+  template <typename queue_t>
+  static cl::sycl::event sycl_copy_conversion(queue_t& dQ, T1* src, T2* dst,
+                                              size_t size, bool async) {
+    if (is_same_allocation(src, dst)) {
+      // The converter never accesses an allocation twice in the same command
+      // group, and the ranges may overlap, so copy through a temporary buffer
+      // instead. The algorithms of algorithms.hpp follow the same rule.
+      // Destroying the temporary buffer waits for the copies, so this path is
+      // always synchronous.
+      cl::sycl::buffer<uint8_t, 1> tmp{cl::sycl::range<1>{size}};
+      dQ.submit([&](cl::sycl::handler& h) {
+        auto acc_src_ =
+            get_range_access<cl::sycl::access::mode::read>(src, size, h);
+        auto acc_tmp_ =
+            tmp.get_access<cl::sycl::access::mode::discard_write>(h);
+        h.copy(acc_src_, acc_tmp_);
+      });
+      return submit_copy(dQ,
+                         [&](cl::sycl::handler& h) {
+                           auto acc_tmp_ =
+                               tmp.get_access<cl::sycl::access::mode::read>(h);
+                           auto acc_dst_ = get_range_access<
+                               cl::sycl::access::mode::discard_write>(dst, size,
+                                                                      h);
+                           h.copy(acc_tmp_, acc_dst_);
+                         },
+                         false);
+    }
+    return submit_copy(
+        dQ,
+        [&](cl::sycl::handler& h) {
+          auto acc_src_ =
+              get_range_access<cl::sycl::access::mode::read>(src, size, h);
+          auto acc_dst_ =
+              get_range_access<cl::sycl::access::mode::discard_write>(dst, size,
+                                                                      h);
+          h.copy(acc_src_, acc_dst_);
+        },
+        async);
+  }
+};
+
+template <typename T1, typename T2>
+struct copy_t<T1, T2, cl::sycl::codeplay::Kind::Default> {
+  template <typename queue_t>
+  static cl::sycl::event sycl_copy_conversion(queue_t& dQ, T1* src, T2* dst,
+                                              size_t size, bool async) {
+    bool src_dev = is_device_pointer(src);
+    bool dst_dev = is_device_pointer(dst);
+    if (src_dev && dst_dev) {
+      return copy_t<T1, T2, Kind::DeviceToDevice>::sycl_copy_conversion(
+          dQ, src, dst, size, async);
+    } else if (src_dev) {
+      return copy_t<T1, T2, Kind::DeviceToHost>::sycl_copy_conversion(
+          dQ, src, dst, size, async);
+    } else if (dst_dev) {
+      return copy_t<T1, T2, Kind::HostToDevice>::sycl_copy_conversion(
+          dQ, src, dst, size, async);
+    }
+    return copy_t<T1, T2, Kind::HostToHost>::sycl_copy_conversion(
+        dQ, src, dst, size, async);
+  }
+};
+
+/** cuda_copy_conversion.
+ * @brief Following the same API ordering as cudaMemCpy , converts the
+ * direct memcpy into a SYCL copy operation, matching directionality.
+ * Only the `size` bytes starting at the given pointers are accessed, so
+ * copies into or out of the middle of an allocation move only the
+ * requested range. With Kind::Default the direction is inferred by looking
+ * the pointers up in the global pointer mapper.
+ *
+ * @param src Pointer to the source
+ * @param dst Pointer to the destination
+ * @param size Number of bytes to copy
+ */
+template <Kind kind_t, typename T1, typename T2>
+cl::sycl::event cuda_copy_conversion(cl::sycl::queue dQ, T1* src, T2* dst,
+                                     size_t size, bool async = false) {
+  if (size == 0) {
+    return cl::sycl::event{};
+  }
+  return copy_t<T1, T2, kind_t>::sycl_copy_conversion(dQ, src, dst, size,
+                                                      async);
+}
+
+/** cuda_copy_conversion.
+ * @brief Converts a cudaMemcpyAsync on the given stream.
+ */
+template <Kind kind_t, typename T1, typename T2>
+cl::sycl::event cuda_copy_conversion(cudaStream_t stream, T1* src, T2* dst,
+                                     size_t size, bool async = true) {
+  if (size == 0) {
+    return cl::sycl::event{};
+  }
+  return copy_t<T1, T2, kind_t>::sycl_copy_conversion(*stream, src, dst, size,
+                                                      async);
+}
+
+template <typename queue_t, typename T>
+static cl::sycl::event sycl_memset_impl(queue_t& dQ, T* dst, int value,
+                                        size_t size, bool async) {
+  if (size == 0) {
+    return cl::sycl::event{};
+  }
+  return submit_copy(
+      dQ,
+      [&](cl::sycl::handler& h) {
+        auto acc = get_range_access<cl::sycl::access::mode::discard_write>(
+            dst, size, h);
+        // The cast to uint8_t is here to match the behaviour of the standard
+        // memset.
+        h.fill(acc, (static_cast<uint8_t>(value)));
+      },
+      async);
+}
+
+template <typename T>
+static cl::sycl::event sycl_memset(cl::sycl::queue dQ, T* dst, int value,
+                                   size_t size, bool async = false) {
+  return sycl_memset_impl(dQ, dst, value, size, async);
+}
+
+/** sycl_memset.
+ * @brief Converts a cudaMemsetAsync on the given stream.
+ */
+template <typename T>
+static cl::sycl::event sycl_memset(cudaStream_t stream, T* dst, int value,
+                                   size_t size, bool async = true) {
+  return sycl_memset_impl(*stream, dst, value, size, async);
+}
+
+template <typename T>
+using acc_t =
+    accessor<T, 1, access::mode::read_write, access::target::global_buffer>;
+using local_acc_t =
+    accessor<uint8_t, 1, access::mode::read_write, access::target::local>;
+
+// This class is used to preserve the original type of the data
+template <typename T1, typename T2>
+struct real_accessor_t;
+template <typename T1, typename T2>
+struct real_accessor_t<T1, acc_t<T2>> {
+  using real_t = std::remove_pointer<T1>;
+  acc_t<T2> acc_;
+  real_accessor_t(acc_t<T2> acc) : acc_(acc) {}
+};
+
+template <typename conv_t>
+struct converter {
+  using type = conv_t;
+  static conv_t inline convert(conv_t c, cl::sycl::handler&) { return c; }
+};
+
+template <typename T>
+struct converter<T*> {
+  using type = real_accessor_t<T, acc_t<uint8_t>>;
+  static type inline convert(T* vir_ptr, cl::sycl::handler& h) {
+    return type(get_global_pointer_mapper().get_access(vir_ptr, h));
+  }
+};
+
+/** resolved_pointer.
+ * @brief A virtual pointer kernel argument whose buffer has already been
+ * looked up in the pointer mapper. It is converted to the same accessor as
+ * the virtual pointer, so the kernel is the same.
+ */
+template <typename T>
+struct resolved_pointer {
+  PointerMapper::buffer_t buffer;
+};
+
+template <typename T>
+struct converter<resolved_pointer<T>> {
+  using type = real_accessor_t<T, acc_t<uint8_t>>;
+  static type inline convert(resolved_pointer<T> ptr, cl::sycl::handler& h) {
+    return type(ptr.buffer.template get_access<access::mode::read_write>(h));
+  }
+};
+
+// Resolves the virtual pointer arguments of a command group to buffers
+template <typename T>
+struct resolver {
+  using type = T;
+  static type resolve(const T& value) { return value; }
+};
+
+template <typename T>
+struct resolver<T*> {
+  using type = resolved_pointer<T>;
+  static type resolve(T* vir_ptr) {
+    return type{get_global_pointer_mapper().get_buffer(vir_ptr)};
+  }
+};
+
+// True for the kernel arguments that refer to device memory
+template <typename T>
+struct is_pointer_param : std::is_pointer<T> {};
+
+template <typename T>
+struct is_pointer_param<resolved_pointer<T>> : std::true_type {};
+
+/** texel_traits.
+ * @brief Maps the element type of a texture to the format of the image
+ * backing it and to the vector type read from and written to the image.
+ * Textures of float, int and unsigned int and of their 4-element vectors are
+ * supported.
+ */
+template <typename T>
+struct texel_traits;
+
+template <>
+struct texel_traits<float> {
+  using texel_t = cl::sycl::float4;
+  static image_channel_order order() { return image_channel_order::r; }
+  static image_channel_type type() { return image_channel_type::fp32; }
+  static float from_texel(texel_t t) { return t.x(); }
+  static texel_t to_texel(float v) { return texel_t(v, 0.0f, 0.0f, 0.0f); }
+};
+
+template <>
+struct texel_traits<cl::sycl::float4> {
+  using texel_t = cl::sycl::float4;
+  static image_channel_order order() { return image_channel_order::rgba; }
+  static image_channel_type type() { return image_channel_type::fp32; }
+  static texel_t from_texel(texel_t t) { return t; }
+  static texel_t to_texel(texel_t v) { return v; }
+};
+
+template <>
+struct texel_traits<int> {
+  using texel_t = cl::sycl::int4;
+  static image_channel_order order() { return image_channel_order::r; }
+  static image_channel_type type() { return image_channel_type::signed_int32; }
+  static int from_texel(texel_t t) { return t.x(); }
+  static texel_t to_texel(int v) { return texel_t(v, 0, 0, 0); }
+};
+
+template <>
+struct texel_traits<cl::sycl::int4> {
+  using texel_t = cl::sycl::int4;
+  static image_channel_order order() { return image_channel_order::rgba; }
+  static image_channel_type type() { return image_channel_type::signed_int32; }
+  static texel_t from_texel(texel_t t) { return t; }
+  static texel_t to_texel(texel_t v) { return v; }
+};
+
+template <>
+struct texel_traits<unsigned int> {
+  using texel_t = cl::sycl::uint4;
+  static image_channel_order order() { return image_channel_order::r; }
+  static image_channel_type type() {
+    return image_channel_type::unsigned_int32;
+  }
+  static unsigned int from_texel(texel_t t) { return t.x(); }
+  static texel_t to_texel(unsigned int v) { return texel_t(v, 0u, 0u, 0u); }
+};
+
+template <>
+struct texel_traits<cl::sycl::uint4> {
+  using texel_t = cl::sycl::uint4;
+  static image_channel_order order() { return image_channel_order::rgba; }
+  static image_channel_type type() {
+    return image_channel_type::unsigned_int32;
+  }
+  static texel_t from_texel(texel_t t) { return t; }
+  static texel_t to_texel(texel_t v) { return v; }
+};
+
+/** texture_desc.
+ * @brief Equivalent of cudaTextureDesc: how a texture is sampled.
+ * Only float textures can be sampled with linear filtering.
+ */
+struct texture_desc {
+  addressing_mode addressing = addressing_mode::clamp_to_edge;
+  filtering_mode filtering = filtering_mode::nearest;
+  coordinate_normalization_mode coordinates =
+      coordinate_normalization_mode::unnormalized;
+};
+
+template <typename T, int Dims>
+class texture_copy_kernel;
+
+/** texture_object.
+ * @brief Equivalent of cudaTextureObject_t: a read-only view of a device
+ * allocation through an image, so reads go through the texture cache and can
+ * be filtered by the sampler.
+ * The image holds a copy of the allocation taken when the texture is created;
+ * update copies the allocation again after it has been modified.
+ * A 2D texture created from linear memory is read with tex1Dfetch: its
+ * elements are laid out in rows of the maximum image width of the device.
+ */
+template <typename T, int Dims>
+class texture_object {
+  static_assert(Dims == 2 || Dims == 3,
+                "Textures are backed by 2D or 3D images");
+
+ public:
+  using texel_t = typename texel_traits<T>::texel_t;
+
+  texture_object(const T* ptr, cl::sycl::range<Dims> extent, size_t count,
+                 const texture_desc& desc)
+      : m_ptr(ptr),
+        m_count(count),
+        m_desc(desc),
+        m_image(std::make_shared<cl::sycl::image<Dims>>(
+            texel_traits<T>::order(), texel_traits<T>::type(), extent)) {}
+
+  /**
+   * Copies the allocation into the image.
+   */
+  template <typename queue_t>
+  cl::sycl::event update(queue_t& q) {
+    auto image = m_image;
+    auto ptr = m_ptr;
+    size_t count = m_count;
+    return q.submit([&](cl::sycl::handler& h) {
+      auto src = get_range_access<cl::sycl::access::mode::read>(
+          ptr, count * sizeof(T), h);
+      auto dst = image->template get_access<texel_t,
+                                            cl::sycl::access::mode::write>(h);
+      auto extent = image->get_range();
+      h.parallel_for<texture_copy_kernel<T, Dims>>(
+          extent, [=](cl::sycl::item<Dims> it) {
+            auto data = reinterpret_cast<const T*>(src.get_pointer().get());
+            size_t idx = get_index(it);
+            T value = (idx < count) ? data[idx] : T();
+            dst.write(get_coords(it), texel_traits<T>::to_texel(value));
+          });
+    });
+  }
+
+  cl::sycl::image<Dims>& get_image() const { return *m_image; }
+  const texture_desc& get_desc() const { return m_desc; }
+  size_t get_width() const { return m_image->get_range()[0]; }
+
+ private:
+  // The range of an image is (width, height, depth), so the first dimension
+  // is the fastest moving one in the allocation
+  static size_t get_index(cl::sycl::item<2> it) {
+    return it.get_id(1) * it.get_range()[0] + it.get_id(0);
+  }
+  static size_t get_index(cl::sycl::item<3> it) {
+    return (it.get_id(2) * it.get_range()[1] + it.get_id(1)) *
+               it.get_range()[0] +
+           it.get_id(0);
+  }
+  static cl::sycl::int2 get_coords(cl::sycl::item<2> it) {
+    return cl::sycl::int2(static_cast<int>(it.get_id(0)),
+                          static_cast<int>(it.get_id(1)));
+  }
+  static cl::sycl::int4 get_coords(cl::sycl::item<3> it) {
+    return cl::sycl::int4(static_cast<int>(it.get_id(0)),
+                          static_cast<int>(it.get_id(1)),
+                          static_cast<int>(it.get_id(2)), 0);
+  }
+
+  const T* m_ptr;
+  size_t m_count;
+  texture_desc m_desc;
+  std::shared_ptr<cl::sycl::image<Dims>> m_image;
+};
+
+
+/**
+ * Creates a texture over the width x height elements of a device allocation,
+ * the equivalent of cudaCreateTextureObject with a pitch 2D resource.
+ */
+template <typename T>
+texture_object<T, 2> create_texture_object(
+    cl::sycl::queue& q, const T* ptr, size_t width, size_t height,
+    const texture_desc& desc = texture_desc()) {
+  texture_object<T, 2> tex(ptr, cl::sycl::range<2>(width, height),
+                           width * height, desc);
+  tex.update(q);
+  return tex;
+}
+
+/**
+ * Creates a texture over the width x height x depth elements of a device
+ * allocation.
+ */
+template <typename T>
+texture_object<T, 3> create_texture_object(
+    cl::sycl::queue& q, const T* ptr, size_t width, size_t height,
+    size_t depth, const texture_desc& desc = texture_desc()) {
+  texture_object<T, 3> tex(ptr, cl::sycl::range<3>(width, height, depth),
+                           width * height * depth, desc);
+  tex.update(q);
+  return tex;
+}
+
+/**
+ * Creates a texture over count elements of a device allocation to be read
+ * with tex1Dfetch, the equivalent of cudaCreateTextureObject with a linear
+ * resource.
+ */
+template <typename T>
+texture_object<T, 2> create_linear_texture_object(cl::sycl::queue& q,
+                                                  const T* ptr,
+                                                  size_t count) {
+  if (count == 0) {
+    throw std::invalid_argument("Cannot create a texture of zero elements");
+  }
+  size_t max_width =
+      q.get_device().get_info<cl::sycl::info::device::image2d_max_width>();
+  size_t width = std::min(count, max_width);
+  size_t height = (count + width - 1) / width;
+  texture_object<T, 2> tex(ptr, cl::sycl::range<2>(width, height), count,
+                           texture_desc());
+  tex.update(q);
+  return tex;
+}
+
+/** texture_accessor_t.
+ * @brief The kernel argument a texture_object is converted to.
+ */
+template <typename T, int Dims>
+struct texture_accessor_t {
+  using texel_t = typename texel_traits<T>::texel_t;
+  accessor<texel_t, Dims, access::mode::read, access::target::image> acc_;
+  cl::sycl::sampler sampler_;
+  int width_;
+
+  // Reads through the sampler of the texture
+  template <typename coords_t>
+  T sample(coords_t coords) const {
+    return texel_traits<T>::from_texel(acc_.read(coords, sampler_));
+  }
+
+  // Reads the texel at the given integer coordinates, without filtering
+  template <typename coords_t>
+  T fetch(coords_t coords) const {
+    return texel_traits<T>::from_texel(acc_.read(coords));
+  }
+};
+
+template <typename T, int Dims>
+struct converter<texture_object<T, Dims>> {
+  using type = texture_accessor_t<T, Dims>;
+  static type inline convert(const texture_object<T, Dims>& tex,
+                             cl::sycl::handler& h) {
+    const texture_desc& desc = tex.get_desc();
+    return type{tex.get_image()
+                    .template get_access<typename type::texel_t,
+                                         access::mode::read>(h),
+                cl::sycl::sampler(desc.coordinates, desc.addressing,
+                                  desc.filtering),
+                static_cast<int>(tex.get_width())};
+  }
+};
+
+/** symbol_registry.
+ * @brief Keeps track of the constant memory used by every constant_symbol,
+ * so it can be checked against the constant memory of the device.
+ */
+class symbol_registry {
+ public:
+  symbol_registry() : m_sizes{} {}
+
+  void register_symbol(const void* key, size_t size) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sizes[key] = size;
+  }
+
+  void unregister_symbol(const void* key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sizes.erase(key);
+  }
+
+  size_t get_total_size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t total = 0;
+    for (auto& s : m_sizes) {
+      total += s.second;
+    }
+    return total;
+  }
+
+  /**
+   * Throws std::length_error if the symbols do not fit in the constant
+   * memory of the given device.
+   */
+  void check_device(const cl::sycl::device& dev) const {
+    auto max_size = static_cast<size_t>(
+        dev.get_info<cl::sycl::info::device::max_constant_buffer_size>());
+    if (get_total_size() > max_size) {
+      throw std::length_error(
+          "The constant symbols do not fit in the constant memory of the "
+          "device");
+    }
+  }
+
+ private:
+  mutable std::mutex m_mutex;
+  std::map<const void*, size_t> m_sizes;
+};
+
+inline symbol_registry& get_global_symbol_registry() {
+  static symbol_registry globalSymbolRegistry_s;
+  return globalSymbolRegistry_s;
+}
+
+/** constant_symbol.
+ * @brief Replaces a __constant__ variable of count elements of type T.
+ * The data lives in a buffer that kernels read through a constant_buffer
+ * accessor, so uniform reads can use the constant cache of the device. The
+ * symbol is passed to the kernel as an argument, which the kernel receives
+ * as a const T* to the constant memory. Copies of a constant_symbol refer to
+ * the same data.
+ */
+template <typename T>
+class constant_symbol {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Constant symbols must be trivially copyable");
+
+ public:
+  using buffer_t = cl::sycl::buffer<uint8_t, 1>;
+
+  explicit constant_symbol(size_t count = 1)
+      : m_state(std::make_shared<state_t>(std::vector<T>(count))) {}
+
+  // Equivalent of an initialized __constant__ array
+  constant_symbol(std::initializer_list<T> init)
+      : m_state(std::make_shared<state_t>(std::vector<T>(init))) {}
+
+  size_t get_count() const { return m_state->size / sizeof(T); }
+  size_t get_size() const { return m_state->size; }
+  buffer_t& get_buffer() const { return m_state->buffer; }
+
+ private:
+  struct state_t {
+    explicit state_t(const std::vector<T>& init)
+        : size(get_checked_size(init)),
+          host(reinterpret_cast<const uint8_t*>(init.data()),
+               reinterpret_cast<const uint8_t*>(init.data()) + size),
+          buffer(host.data(), cl::sycl::range<1>{size}) {
+      buffer.set_final_data(nullptr);
+      get_global_symbol_registry().register_symbol(this, size);
+    }
+
+    ~state_t() { get_global_symbol_registry().unregister_symbol(this); }
+
+    static size_t get_checked_size(const std::vector<T>& init) {
+      if (init.empty()) {
+        throw std::invalid_argument("Constant symbols cannot be empty");
+      }
+      return init.size() * sizeof(T);
+    }
+
+    size_t size;
+    // Initial contents, which must outlive the buffer
+    std::vector<uint8_t> host;
+    buffer_t buffer;
+  };
+
+  std::shared_ptr<state_t> m_state;
+};
+
+/** constant_accessor_t.
+ * @brief The kernel argument a constant_symbol is converted to.
+ */
+template <typename T>
+struct constant_accessor_t {
+  accessor<uint8_t, 1, access::mode::read, access::target::constant_buffer>
+      acc_;
+};
+
+template <typename T>
+struct converter<constant_symbol<T>> {
+  using type = constant_accessor_t<T>;
+  static type inline convert(const constant_symbol<T>& symbol,
+                             cl::sycl::handler& h) {
+    return type{symbol.get_buffer()
+                    .template get_access<access::mode::read,
+                                         access::target::constant_buffer>(h)};
+  }
+};
+
+template <typename T>
+void check_symbol_range(const constant_symbol<T>& symbol, size_t count,
+                        size_t offset) {
+  if (offset + count > symbol.get_size()) {
+    throw std::out_of_range("The copy exceeds the size of the symbol");
+  }
+}
+
+template <typename queue_t>
+cl::sycl::device get_queue_device(queue_t& dQ) {
+  return dQ.get_device();
+}
+
+inline cl::sycl::device get_queue_device(stream_t& stream) {
+  return stream.get_queue().get_device();
+}
+
+/** sycl_memcpy_to_symbol.
+ * @brief Converts a cudaMemcpyToSymbol: copies count bytes from host memory
+ * to the symbol, starting offset bytes into it.
+ */
+template <typename queue_t, typename T>
+cl::sycl::event sycl_memcpy_to_symbol(queue_t& dQ, constant_symbol<T>& symbol,
+                                      const void* src, size_t count,
+                                      size_t offset = 0, bool async = false) {
+  check_symbol_range(symbol, count, offset);
+  get_global_symbol_registry().check_device(get_queue_device(dQ));
+  if (count == 0) {
+    return cl::sycl::event{};
+  }
+  auto& buf = symbol.get_buffer();
+  return submit_copy(
+      dQ,
+      [&](cl::sycl::handler& h) {
+        auto acc = buf.template get_access<access::mode::discard_write>(
+            h, cl::sycl::range<1>{count}, cl::sycl::id<1>{offset});
+        h.copy(static_cast<const uint8_t*>(src), acc);
+      },
+      async);
+}
+
+template <typename T>
+cl::sycl::event sycl_memcpy_to_symbol(cudaStream_t stream,
+                                      constant_symbol<T>& symbol,
+                                      const void* src, size_t count,
+                                      size_t offset = 0, bool async = true) {
+  return sycl_memcpy_to_symbol(*stream, symbol, src, count, offset, async);
+}
+
+/** sycl_memcpy_from_symbol.
+ * @brief Converts a cudaMemcpyFromSymbol: copies count bytes of the symbol,
+ * starting offset bytes into it, to host memory.
+ */
+template <typename queue_t, typename T>
+cl::sycl::event sycl_memcpy_from_symbol(queue_t& dQ, void* dst,
+                                        constant_symbol<T>& symbol,
+                                        size_t count, size_t offset = 0,
+                                        bool async = false) {
+  check_symbol_range(symbol, count, offset);
+  if (count == 0) {
+    return cl::sycl::event{};
+  }
+  auto& buf = symbol.get_buffer();
+  return submit_copy(
+      dQ,
+      [&](cl::sycl::handler& h) {
+        auto acc = buf.template get_access<access::mode::read>(
+            h, cl::sycl::range<1>{count}, cl::sycl::id<1>{offset});
+        h.copy(acc, static_cast<uint8_t*>(dst));
+      },
+      async);
+}
+
+template <typename T>
+cl::sycl::event sycl_memcpy_from_symbol(cudaStream_t stream, void* dst,
+                                        constant_symbol<T>& symbol,
+                                        size_t count, size_t offset = 0,
+                                        bool async = true) {
+  return sycl_memcpy_from_symbol(*stream, dst, symbol, count, offset, async);
+}
+
+/* Number of work-items in an emulated warp when sub-groups are not
+ * available. */
+#ifndef COMPATIBILITY_WARP_SIZE
+#define COMPATIBILITY_WARP_SIZE 32
+#endif
+
+/** local_array2d.
+ * @brief A rows x cols array in local memory whose rows are padded to
+ * stride elements, to spread the columns over different memory banks.
+ */
+template <typename T>
+struct local_array2d {
+  T* data;
+  size_t stride;
+
+  T& operator()(size_t row, size_t col) const {
+    return data[row * stride + col];
+  }
+};
+
+/** local_arena.
+ * @brief Bump allocator over the dynamic local memory of a work-group, in the
+ * spirit of the stack_allocator sample.
+ * Every work-item of the work-group must request the same arrays in the same
+ * order, so they all get the same addresses. Arrays are never released; the
+ * arena is constructed again at the start of each kernel.
+ * On the host, an arena without memory computes the number of bytes that
+ * the requested arrays need, which is the local memory size to launch with:
+ *   cl::sycl::codeplay::local_arena sizing;
+ *   sizing.allocate<float>(blockSize);
+ *   sizing.allocate_2d<double>(32, 32, 1);
+ *   CudaCommandGroup<...>(gridSize, blockSize, sizing.get_size(), ...);
+ */
+class local_arena {
+ public:
+  // Alignment of the start of the arena, which bounds the alignment of the
+  // arrays allocated from it. Nothing guarantees the alignment of the local
+  // memory, so the start is aligned when the arena is constructed.
+  static constexpr size_t base_alignment = 64;
+
+  local_arena() : m_base(nullptr), m_capacity(0), m_offset(0) {}
+
+  local_arena(uint8_t* base, size_t capacity)
+      : m_base(nullptr), m_capacity(0), m_offset(0) {
+    size_t pad = (base_alignment -
+                  reinterpret_cast<std::uintptr_t>(base) % base_alignment) %
+                 base_alignment;
+    if (pad <= capacity) {
+      m_base = base + pad;
+      m_capacity = capacity - pad;
+    }
+  }
+
+  /**
+   * Returns an array of count elements aligned to Align bytes, or nullptr
+   * if it does not fit in the local memory requested at launch. An arena
+   * without memory always returns nullptr.
+   */
+  template <typename T, size_t Align = alignof(T)>
+  T* allocate(size_t count) {
+    static_assert(Align != 0 && (Align & (Align - 1)) == 0,
+                  "The alignment must be a power of two");
+    static_assert(Align <= base_alignment,
+                  "The alignment exceeds the alignment of the arena");
+    size_t start = (m_offset + Align - 1) & ~(Align - 1);
+    m_offset = start + count * sizeof(T);
+    if (!m_base || m_offset > m_capacity) {
+      return nullptr;
+    }
+    return reinterpret_cast<T*>(m_base + start);
+  }
+
+  /**
+   * Returns a rows x cols array whose rows are followed by padding unused
+   * elements, e.g. a padding of 1 for a 32 x 32 float tile read by column.
+   */
+  template <typename T, size_t Align = alignof(T)>
+  local_array2d<T> allocate_2d(size_t rows, size_t cols, size_t padding = 0) {
+    size_t stride = cols + padding;
+    return local_array2d<T>{allocate<T, Align>(rows * stride), stride};
+  }
+
+  // Bytes needed by the arrays allocated so far, including their alignment
+  // and the padding that may be needed to align the start of the arena
+  size_t get_size() const {
+    return m_offset == 0 ? 0 : m_offset + base_alignment - 1;
+  }
+
+ private:
+  uint8_t* m_base;
+  size_t m_capacity;
+  size_t m_offset;
+};
+
+/** uses_warp_scratch.
+ * @brief Whether the converted kernel functor kernel_t calls warp-level
+ * intrinsics. Kernels opt in by declaring
+ *   static constexpr bool uses_warp_intrinsics = true;
+ * so that launches of other kernels do not reserve the warp scratch area.
+ */
+template <typename kernel_t, typename = void>
+struct uses_warp_scratch : std::false_type {};
+
+template <typename kernel_t>
+struct uses_warp_scratch<
+    kernel_t, typename std::enable_if<kernel_t::uses_warp_intrinsics>::type>
+    : std::true_type {};
+
+/** uniform_warp_calls.
+ * @brief Whether every work-item of a block of the converted kernel functor
+ * kernel_t reaches each of its calls to warp-level intrinsics. Without
+ * sub-groups the intrinsics are emulated with work-group barriers, so a call
+ * made by only some of the warps, as in the usual final-warp reduction under
+ * `if (tid < 32)`, would deadlock. On that path kernels must confirm it by
+ * declaring
+ *   static constexpr bool uniform_warp_calls = true;
+ */
+template <typename kernel_t, typename = void>
+struct has_uniform_warp_calls : std::false_type {};
+
+template <typename kernel_t>
+struct has_uniform_warp_calls<
+    kernel_t, typename std::enable_if<kernel_t::uniform_warp_calls>::type>
+    : std::true_type {};
+
+/** warp_scratch.
+ * @brief Local memory reserved at the start of the dynamic local buffer to
+ * emulate warp-level operations when sub-groups are not available.
+ * One slot per work-item is reserved, large enough for any scalar up to
+ * 8 bytes, for the kernels that opt in through uses_warp_scratch. On the
+ * SYCL 2020 path warp operations map to sub-groups and no local memory is
+ * reserved.
+ */
+struct warp_scratch {
+#if COMPATIBILITY_SYCL_2020
+  static constexpr size_t bytes_per_item = 0;
+#else
+  static constexpr size_t bytes_per_item = 8;
+#endif
+  // Bytes reserved for a block of the kernel functor kernel_t, rounded up so
+  // the memory after it keeps the alignment of the arena
+  template <typename kernel_t>
+  static size_t get_size(dim3 blockSize) {
+    if (!uses_warp_scratch<kernel_t>::value) {
+      return 0;
+    }
+    size_t size = bytes_per_item * blockSize.x * blockSize.y * blockSize.z;
+    return (size + local_arena::base_alignment - 1) &
+           ~(local_arena::base_alignment - 1);
+  }
+};
+
+/** warp_ops.
+ * @brief Binary operations for warp reductions. On the SYCL 2020 path they
+ * are the SYCL function objects, the only operations reduce_over_group
+ * accepts.
+ */
+namespace warp_ops {
+#if COMPATIBILITY_SYCL_2020
+template <typename T>
+using plus = cl::sycl::plus<T>;
+template <typename T>
+using minimum = cl::sycl::minimum<T>;
+template <typename T>
+using maximum = cl::sycl::maximum<T>;
+template <typename T>
+using bit_or = cl::sycl::bit_or<T>;
+template <typename T>
+using bit_and = cl::sycl::bit_and<T>;
+#else
+template <typename T>
+struct plus {
+  T operator()(const T& a, const T& b) const { return a + b; }
+};
+template <typename T>
+struct minimum {
+  T operator()(const T& a, const T& b) const { return (b < a) ? b : a; }
+};
+template <typename T>
+struct maximum {
+  T operator()(const T& a, const T& b) const { return (a < b) ? b : a; }
+};
+template <typename T>
+struct bit_or {
+  T operator()(const T& a, const T& b) const { return a | b; }
+};
+template <typename T>
+struct bit_and {
+  T operator()(const T& a, const T& b) const { return a & b; }
+};
+#endif
+}  // namespace warp_ops
+
+/** atomic_ops.
+ * @brief Atomic read-modify-write operations on global or local memory.
+ * On the SYCL 2020 path every operation maps to an atomic_ref. Otherwise
+ * integral types use cl::sycl::atomic directly, while floating point types
+ * are handled by a compare-and-swap loop over an unsigned integer of the same
+ * size; double therefore requires 64-bit atomics on the device.
+ * All operations return the value stored at the address before the update,
+ * and use relaxed memory ordering as CUDA does.
+ */
+template <cl::sycl::access::address_space Space>
+struct atomic_ops {
+#if COMPATIBILITY_SYCL_2020
+  template <typename T>
+  using atomic_t = cl::sycl::atomic_ref<T, cl::sycl::memory_order::relaxed,
+                                        cl::sycl::memory_scope::device, Space>;
+
+  template <typename T>
+  static T fetch_add(T* address, T val) {
+    return atomic_t<T>(*address).fetch_add(val);
+  }
+  template <typename T>
+  static T fetch_sub(T* address, T val) {
+    return atomic_t<T>(*address).fetch_sub(val);
+  }
+  template <typename T>
+  static T fetch_max(T* address, T val) {
+    return atomic_t<T>(*address).fetch_max(val);
+  }
+  template <typename T>
+  static T fetch_min(T* address, T val) {
+    return atomic_t<T>(*address).fetch_min(val);
+  }
+  template <typename T>
+  static T exchange(T* address, T val) {
+    return atomic_t<T>(*address).exchange(val);
+  }
+  template <typename T>
+  static T compare_exchange(T* address, T compare, T val) {
+    atomic_t<T>(*address).compare_exchange_strong(compare, val);
+    return compare;
+  }
+#else
+  template <typename T>
+  using atomic_t = cl::sycl::atomic<T, Space>;
+
+  template <typename T>
+  static atomic_t<T> make_atomic(T* address) {
+    return atomic_t<T>(cl::sycl::multi_ptr<T, Space>(address));
+  }
+
+  // Unsigned integer type used to operate on the bits of a floating point
+  template <typename T>
+  struct bits_type {
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8,
+                  "Only 32 and 64 bit types are supported");
+    using type = typename std::conditional<sizeof(T) == 4, uint32_t,
+                                           uint64_t>::type;
+  };
+
+  template <typename T>
+  union bits_cast {
+    T value;
+    typename bits_type<T>::type bits;
+  };
+
+  // Replaces *address by op(*address) with a compare-and-swap loop
+  template <typename T, typename op_t>
+  static T cas_loop(T* address, op_t op) {
+    using bits_t = typename bits_type<T>::type;
+    auto a = make_atomic(reinterpret_cast<bits_t*>(address));
+    bits_cast<T> old_val, new_val;
+    old_val.bits = a.load();
+    do {
+      new_val.value = op(old_val.value);
+    } while (!a.compare_exchange_strong(old_val.bits, new_val.bits));
+    return old_val.value;
+  }
+
+  template <typename T>
+  static T fetch_add(T* address, T val, std::true_type) {
+    return make_atomic(address).fetch_add(val);
+  }
+  template <typename T>
+  static T fetch_add(T* address, T val, std::false_type) {
+    return cas_loop(address, [=](T old) { return old + val; });
+  }
+  template <typename T>
+  static T fetch_sub(T* address, T val, std::true_type) {
+    return make_atomic(address).fetch_sub(val);
+  }
+  template <typename T>
+  static T fetch_sub(T* address, T val, std::false_type) {
+    return cas_loop(address, [=](T old) { return old - val; });
+  }
+  template <typename T>
+  static T fetch_max(T* address, T val, std::true_type) {
+    return make_atomic(address).fetch_max(val);
+  }
+  template <typename T>
+  static T fetch_max(T* address, T val, std::false_type) {
+    return cas_loop(address, [=](T old) { return (old < val) ? val : old; });
+  }
+  template <typename T>
+  static T fetch_min(T* address, T val, std::true_type) {
+    return make_atomic(address).fetch_min(val);
+  }
+  template <typename T>
+  static T fetch_min(T* address, T val, std::false_type) {
+    return cas_loop(address, [=](T old) { return (val < old) ? val : old; });
+  }
+  template <typename T>
+  static T exchange(T* address, T val, std::true_type) {
+    return make_atomic(address).exchange(val);
+  }
+  template <typename T>
+  static T exchange(T* address, T val, std::false_type) {
+    using bits_t = typename bits_type<T>::type;
+    bits_cast<T> old_val, new_val;
+    new_val.value = val;
+    old_val.bits =
+        make_atomic(reinterpret_cast<bits_t*>(address)).exchange(new_val.bits);
+    return old_val.value;
+  }
+  template <typename T>
+  static T compare_exchange(T* address, T compare, T val, std::true_type) {
+    make_atomic(address).compare_exchange_strong(compare, val);
+    return compare;
+  }
+  template <typename T>
+  static T compare_exchange(T* address, T compare, T val, std::false_type) {
+    using bits_t = typename bits_type<T>::type;
+    bits_cast<T> expected, desired;
+    expected.value = compare;
+    desired.value = val;
+    make_atomic(reinterpret_cast<bits_t*>(address))
+        .compare_exchange_strong(expected.bits, desired.bits);
+    return expected.value;
+  }
+
+  template <typename T>
+  using is_native = std::is_integral<T>;
+
+  template <typename T>
+  static T fetch_add(T* address, T val) {
+    return fetch_add(address, val, is_native<T>());
+  }
+  template <typename T>
+  static T fetch_sub(T* address, T val) {
+    return fetch_sub(address, val, is_native<T>());
+  }
+  template <typename T>
+  static T fetch_max(T* address, T val) {
+    return fetch_max(address, val, is_native<T>());
+  }
+  template <typename T>
+  static T fetch_min(T* address, T val) {
+    return fetch_min(address, val, is_native<T>());
+  }
+  template <typename T>
+  static T exchange(T* address, T val) {
+    return exchange(address, val, is_native<T>());
+  }
+  template <typename T>
+  static T compare_exchange(T* address, T compare, T val) {
+    return compare_exchange(address, compare, val, is_native<T>());
+  }
+#endif
+};
+
+/** launch_config.
+ * @brief Maps a CUDA grid onto an nd_range of the given dimensionality and
+ * recovers the CUDA built-in variables from the nd_item.
+ * CUDA's x dimension is mapped to dimension 0. Lower-dimensional launches
+ * require the unused dimensions of the grid and block to be 1, and avoid
+ * the per work-item queries of the unused dimensions.
  */
-template <Kind kind_t, typename T1, typename T2>
-cl::sycl::event cuda_copy_conversion(cl::sycl::queue dQ, T1* src, T2* dst,
-                                     size_t, bool async = false) {
-  return copy_t<T1, T2, kind_t>::sycl_copy_conversion(dQ, src, dst, async);
-}
+template <int Dims>
+struct launch_config;
 
-template <typename T>
-static cl::sycl::event sycl_memset(cl::sycl::queue dQ, T* dst, int value,
-                                   size_t, bool async = false) {
-  auto event = dQ.submit([&](cl::sycl::handler& h) {
-    auto acc = get_global_pointer_mapper().get_access(dst, h);
-    // The cast to uint8_t is here to match the behaviour of the standard
-    // memset.
-    h.fill(acc, (static_cast<uint8_t>(value)));
-  });
-  if (!async) {
-    event.wait();
+template <>
+struct launch_config<1> {
+  static cl::sycl::nd_range<1> get_nd_range(dim3 gridSize, dim3 blockSize) {
+    return {cl::sycl::range<1>(gridSize.x * blockSize.x),
+            cl::sycl::range<1>(blockSize.x)};
   }
-  return event;
-}
-
-template <typename T>
-using acc_t =
-    accessor<T, 1, access::mode::read_write, access::target::global_buffer>;
-using local_acc_t =
-    accessor<uint8_t, 1, access::mode::read_write, access::target::local>;
+  static bool is_valid(dim3 gridSize, dim3 blockSize) {
+    return (gridSize.y == 1) && (gridSize.z == 1) && (blockSize.y == 1) &&
+           (blockSize.z == 1);
+  }
+  static void get_ids(const cl::sycl::nd_item<1>& it, dim3& blockIdx,
+                      dim3& threadIdx, dim3& blockDim, dim3& gridDim) {
+    blockIdx = dim3(it.get_group(0), 0, 0);
+    threadIdx = dim3(it.get_local_id(0), 0, 0);
+    blockDim = dim3(it.get_local_range(0), 1, 1);
+    gridDim = dim3(it.get_group_range(0), 1, 1);
+  }
+};
 
-// This class is used to preserve the original type of the data
-template <typename T1, typename T2>
-struct real_accessor_t;
-template <typename T1, typename T2>
-struct real_accessor_t<T1, acc_t<T2>> {
-  using real_t = std::remove_pointer<T1>;
-  acc_t<T2> acc_;
-  real_accessor_t(acc_t<T2> acc) : acc_(acc) {}
+template <>
+struct launch_config<2> {
+  static cl::sycl::nd_range<2> get_nd_range(dim3 gridSize, dim3 blockSize) {
+    auto globalrange = (gridSize * blockSize);
+    return {cl::sycl::range<2>(globalrange.x, globalrange.y),
+            cl::sycl::range<2>(blockSize.x, blockSize.y)};
+  }
+  static bool is_valid(dim3 gridSize, dim3 blockSize) {
+    return (gridSize.z == 1) && (blockSize.z == 1);
+  }
+  static void get_ids(const cl::sycl::nd_item<2>& it, dim3& blockIdx,
+                      dim3& threadIdx, dim3& blockDim, dim3& gridDim) {
+    blockIdx = dim3(it.get_group(0), it.get_group(1), 0);
+    threadIdx = dim3(it.get_local_id(0), it.get_local_id(1), 0);
+    blockDim = dim3(it.get_local_range(0), it.get_local_range(1), 1);
+    gridDim = dim3(it.get_group_range(0), it.get_group_range(1), 1);
+  }
 };
 
-template <typename conv_t>
-struct converter {
-  using type = conv_t;
-  static conv_t inline convert(conv_t c, cl::sycl::handler&) { return c; }
+template <>
+struct launch_config<3> {
+  static cl::sycl::nd_range<3> get_nd_range(dim3 gridSize, dim3 blockSize) {
+    auto globalrange = (gridSize * blockSize);
+    return {cl::sycl::range<3>(globalrange.x, globalrange.y, globalrange.z),
+            cl::sycl::range<3>(blockSize.x, blockSize.y, blockSize.z)};
+  }
+  static bool is_valid(dim3, dim3) { return true; }
+  static void get_ids(const cl::sycl::nd_item<3>& it, dim3& blockIdx,
+                      dim3& threadIdx, dim3& blockDim, dim3& gridDim) {
+    blockIdx = dim3(it.get_group(0), it.get_group(1), it.get_group(2));
+    threadIdx = dim3(it.get_local_id(0), it.get_local_id(1),
+                     it.get_local_id(2));
+    blockDim = dim3(it.get_local_range(0), it.get_local_range(1),
+                    it.get_local_range(2));
+    gridDim = dim3(it.get_group_range(0), it.get_group_range(1),
+                   it.get_group_range(2));
+  }
 };
 
 template <typename T>
-struct converter<T*> {
-  using type = real_accessor_t<T, acc_t<uint8_t>>;
-  static type inline convert(T* vir_ptr, cl::sycl::handler& h) {
-    return type(get_global_pointer_mapper().get_access(vir_ptr, h));
-  }
+struct nd_item_dims;
+template <int Dims>
+struct nd_item_dims<cl::sycl::nd_item<Dims>> {
+  static constexpr int value = Dims;
 };
 
+/* The kernel parameters are passed to the user kernel type as const
+ * references, so the user functor constructed for every work-item refers to
+ * the parameters stored in the dispatcher instead of copying them. */
 template <typename functor_t>
 struct kernel_dispatcher;
 template <typename blockIdx_t, typename threadIdx_t, typename blockDim_t,
@@ -177,28 +2071,25 @@ struct kernel_dispatcher<user_kernel_t<blockIdx_t, threadIdx_t, blockDim_t,
                                        gridDim_t, nd_item_t, Param_t...>> {
   using type = user_kernel_t<blockIdx_t, threadIdx_t, blockDim_t, gridDim_t,
                              nd_item_t, Param_t...>;
-  utility::tuple::Tuple<Param_t...> t;
-  blockIdx_t blockIdx;
-  threadIdx_t threadIdx;
-  blockDim_t blockDim;
-  gridDim_t gridDim;
+  utility::tuple::Tuple<typename std::decay<Param_t>::type...> t;
 
-  kernel_dispatcher(Param_t... param)
-      : t(utility::tuple::make_tuple(param...)){};
+  kernel_dispatcher(Param_t... param) : t(param...){};
   void operator()(nd_item_t it_) {
-    blockIdx = blockIdx_t(it_.get_group(0), it_.get_group(1), it_.get_group(2));
-    threadIdx = threadIdx_t(it_.get_local_id(0), it_.get_local_id(1),
-                            it_.get_local_id(2));
-    blockDim = blockDim_t(it_.get_local_range(0), it_.get_local_range(1),
-                          it_.get_local_range(2));
-    gridDim = gridDim_t(it_.get_group_range(0), it_.get_group_range(1),
-                        it_.get_group_range(2));
+    blockIdx_t blockIdx;
+    threadIdx_t threadIdx;
+    blockDim_t blockDim;
+    gridDim_t gridDim;
+    launch_config<nd_item_dims<nd_item_t>::value>::get_ids(
+        it_, blockIdx, threadIdx, blockDim, gridDim);
 
-    caller(it_, utility::tuple::IndexRange<0, sizeof...(Param_t)>());
+    caller(it_, blockIdx, threadIdx, blockDim, gridDim,
+           utility::tuple::IndexRange<0, sizeof...(Param_t)>());
   }
 
   template <size_t... Is>
-  void caller(cl::sycl::nd_item<3> it, utility::tuple::IndexList<Is...>) {
+  void caller(nd_item_t it, blockIdx_t blockIdx, threadIdx_t threadIdx,
+              blockDim_t blockDim, gridDim_t gridDim,
+              utility::tuple::IndexList<Is...>) {
     auto kernel_functor = type(blockIdx, threadIdx, blockDim, gridDim, it,
                                utility::tuple::get<Is>(t)...);
     kernel_functor.wrapper(
@@ -206,24 +2097,147 @@ struct kernel_dispatcher<user_kernel_t<blockIdx_t, threadIdx_t, blockDim_t,
   }
 };
 
-template <typename kernel>
-struct CudaCommandGroup;
-template <typename... Param_t, template <class...> class KernelT>
-class CudaCommandGroup<KernelT<Param_t...>> {
+/** kernel_registry.
+ * @brief Builds the kernels of converted command groups ahead of their first
+ * launch, so the program build does not happen inside the first submit.
+ * Kernels are built on a background thread for the context of the given
+ * queue. Command groups launched with use_registry take the kernel from the
+ * registry, waiting for its build to finish if necessary; kernels that were
+ * never registered are built by the runtime as usual.
+ */
+class kernel_registry {
+ public:
+  explicit kernel_registry(const cl::sycl::queue& q)
+      : m_context(q.get_context()), m_kernels{} {}
+
+  ~kernel_registry() { wait(); }
+
+  /**
+   * Starts building the kernels of the given command group types, e.g.
+   * prebuild<CudaCommandGroup<___CudaConverterFunctor___add<...>, 1>>().
+   * Command groups already registered are not built again.
+   */
+  template <typename... command_group_t>
+  void prebuild() {
+    std::vector<std::pair<std::type_index, build_fn_t>> builds;
+    add_builds<command_group_t...>(builds);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& b : builds) {
+      if (m_kernels.find(b.first) == m_kernels.end()) {
+        m_kernels.emplace(
+            b.first, std::async(std::launch::async, b.second, m_context));
+      }
+    }
+  }
+
+  /**
+   * Returns the built kernel for the given kernel type, waiting for its build
+   * to finish, or nullptr if the kernel type was never registered.
+   */
+  template <typename kernel_t>
+  const cl::sycl::kernel* find_kernel() const {
+    std::shared_future<cl::sycl::kernel> build;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_kernels.find(std::type_index(typeid(kernel_t)));
+      if (it == m_kernels.end()) {
+        return nullptr;
+      }
+      build = it->second;
+    }
+    // The future stored in the map shares the state, which outlives the copy
+    return &build.get();
+  }
+
+  /**
+   * Waits for every registered build to finish.
+   */
+  void wait() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& k : m_kernels) {
+      k.second.wait();
+    }
+  }
+
+  const cl::sycl::context& get_context() const { return m_context; }
+
+ private:
+  using build_fn_t = cl::sycl::kernel (*)(cl::sycl::context);
+
+  template <typename kernel_t>
+  static cl::sycl::kernel build(cl::sycl::context ctx) {
+    cl::sycl::program program(ctx);
+    program.build_with_kernel_type<kernel_t>();
+    return program.get_kernel<kernel_t>();
+  }
+
+  template <typename... command_group_t>
+  static typename std::enable_if<sizeof...(command_group_t) == 0>::type
+  add_builds(std::vector<std::pair<std::type_index, build_fn_t>>&) {}
+
+  template <typename command_group_t, typename... rest_t>
+  static void add_builds(
+      std::vector<std::pair<std::type_index, build_fn_t>>& builds) {
+    using kernel_t = typename command_group_t::kernel_type;
+    builds.emplace_back(std::type_index(typeid(kernel_t)), &build<kernel_t>);
+    add_builds<rest_t...>(builds);
+  }
+
+  cl::sycl::context m_context;
+  mutable std::mutex m_mutex;
+  std::map<std::type_index, std::shared_future<cl::sycl::kernel>> m_kernels;
+};
+
+/** CudaCommandGroup.
+ * @brief Command group functor that launches a converted CUDA kernel.
+ * Dims selects the dimensionality of the nd_range at compile time. Kernels
+ * launched with 1D or 2D grids should use Dims = 1 or Dims = 2, which avoids
+ * computing the unused dimensions of the CUDA built-in variables for every
+ * work-item.
+ * @throw std::invalid_argument if the grid or block sizes use more dimensions
+ * than Dims, or, with SYCL 2020 sub-groups, if a kernel calling warp
+ * intrinsics is launched with a multi-dimensional block
+ */
+template <typename kernel, int Dims = 3>
+class CudaCommandGroup;
+template <typename... Param_t, template <class...> class KernelT, int Dims>
+class CudaCommandGroup<KernelT<Param_t...>, Dims> {
  private:
   dim3 gridSize_;
   dim3 blockSize_;
   int local_mem_size_;
   // kernel parameters
   utility::tuple::Tuple<Param_t...> t;
+  const kernel_registry* registry_;
 
  public:
+  // Type of the SYCL kernel launched by the command group
+  using kernel_type = kernel_dispatcher<
+      KernelT<dim3, dim3, dim3, dim3, cl::sycl::nd_item<Dims>,
+              const typename converter<Param_t>::type&...,
+              const typename converter<local_acc_t>::type&>>;
+
   CudaCommandGroup(dim3 gridSize, dim3 blockSize, int local_mem_size,
                    Param_t... param)
       : gridSize_{gridSize},
         blockSize_{blockSize},
         local_mem_size_{local_mem_size},
-        t{utility::tuple::make_tuple(param...)} {}
+        t{utility::tuple::make_tuple(param...)},
+        registry_{nullptr} {
+    if (!launch_config<Dims>::is_valid(gridSize_, blockSize_)) {
+      throw std::invalid_argument(
+          "The launch uses more dimensions than the command group");
+    }
+#if COMPATIBILITY_SYCL_2020
+    // Sub-groups run along the last SYCL dimension rather than threadIdx.x,
+    // so they only hold the threads of CUDA warps in one-dimensional blocks
+    if (uses_warp_scratch<typename kernel_type::type>::value &&
+        (blockSize_.y > 1 || blockSize_.z > 1)) {
+      throw std::invalid_argument(
+          "Kernels calling warp intrinsics need one-dimensional blocks");
+    }
+#endif
+  }
   CudaCommandGroup(dim3 gridSize, dim3 blockSize, Param_t... param)
       : CudaCommandGroup(gridSize, blockSize, sizeof(void*), param...) {}
   CudaCommandGroup(int gridSize, int blockSize, int local_mem_size,
@@ -232,33 +2246,347 @@ class CudaCommandGroup<KernelT<Param_t...>> {
                          local_mem_size, param...) {}
   CudaCommandGroup(int gridSize, int blockSize, Param_t... param)
       : CudaCommandGroup(gridSize, blockSize, sizeof(void*), param...) {}
+  // The same command group with its pointer arguments resolved to buffers
+  using resolved_type =
+      CudaCommandGroup<KernelT<typename resolver<Param_t>::type...>, Dims>;
+
+  /**
+   * Returns a copy of the command group whose virtual pointer arguments have
+   * been resolved to their buffers, so launching it does not look them up in
+   * the pointer mapper again.
+   */
+  resolved_type resolve() const {
+    return resolve_impl(utility::tuple::IndexRange<0, sizeof...(Param_t)>());
+  }
+
+  /**
+   * Replaces the I-th kernel argument, which must not be a pointer.
+   */
+  template <size_t I, typename T>
+  void set_param(T value) {
+    using param_t = typename utility::tuple::ElemTypeHolder<
+        I, utility::tuple::Tuple<Param_t...>>::type;
+    static_assert(!is_pointer_param<param_t>::value,
+                  "Only scalar kernel arguments can be updated");
+    utility::tuple::get<I>(t) = static_cast<param_t>(value);
+  }
+
+  /**
+   * Launches the kernel prebuilt by the registry, if it was registered. The
+   * registry must outlive the submission of the command group.
+   */
+  CudaCommandGroup& use_registry(const kernel_registry& registry) {
+    registry_ = &registry;
+    return *this;
+  }
   void operator()(cl::sycl::handler& h) {
     auto t2 = utility::tuple::append(
-        t, utility::tuple::make_tuple(local_acc_t(local_mem_size_, h)));
+        t, utility::tuple::make_tuple(local_acc_t(
+               local_mem_size_ +
+                   warp_scratch::get_size<typename kernel_type::type>(
+                       blockSize_),
+               h)));
     caller(h, t2, utility::tuple::IndexRange<0, sizeof...(Param_t) + 1>());
   }
   template <typename handler_t, typename... append_param_t, size_t... Is>
   void caller(handler_t& h, utility::tuple::Tuple<append_param_t...> t2,
               utility::tuple::IndexList<Is...>) {
-    auto globalrange = (gridSize_ * blockSize_);
-    using u_ker_t = KernelT<dim3, dim3, dim3, dim3, cl::sycl::nd_item<3>,
-                            typename converter<append_param_t>::type...>;
+    using u_ker_t =
+        KernelT<dim3, dim3, dim3, dim3, cl::sycl::nd_item<Dims>,
+                const typename converter<append_param_t>::type&...>;
     using kernel_t = kernel_dispatcher<u_ker_t>;
     auto func = kernel_t((
         converter<append_param_t>::convert(utility::tuple::get<Is>(t2), h))...);
-    h.parallel_for(
-        nd_range<3>{
-            cl::sycl::range<3>(globalrange.x, globalrange.y, globalrange.z),
-            cl::sycl::range<3>(blockSize_.x, blockSize_.y, blockSize_.z)},
-        func);
+    auto range = launch_config<Dims>::get_nd_range(gridSize_, blockSize_);
+    const cl::sycl::kernel* k =
+        registry_ ? registry_->find_kernel<kernel_t>() : nullptr;
+    if (k) {
+      h.parallel_for(*k, range, func);
+    } else {
+      h.parallel_for(range, func);
+    }
+  }
+
+ private:
+  template <size_t... Is>
+  resolved_type resolve_impl(utility::tuple::IndexList<Is...>) const {
+    resolved_type resolved(gridSize_, blockSize_, local_mem_size_,
+                           resolver<Param_t>::resolve(
+                               utility::tuple::get<Is>(t))...);
+    if (registry_) {
+      resolved.use_registry(*registry_);
+    }
+    return resolved;
+  }
+};
+
+/** occupancy_t.
+ * @brief Launch configuration suggested by max_potential_block_size.
+ */
+struct occupancy_t {
+  // Smallest grid that fills every compute unit of the device
+  int min_grid_size;
+  int block_size;
+
+  // Number of blocks of block_size needed to cover n work-items
+  int get_grid_size(size_t n) const {
+    return static_cast<int>((n + block_size - 1) / block_size);
+  }
+};
+
+/**
+ * Equivalent of cudaOccupancyMaxPotentialBlockSizeVariableSMem: returns the
+ * block size that keeps the most work-items resident on each compute unit
+ * for the kernel of the given command group, and the grid size that fills
+ * the device with it.
+ * Block sizes are multiples of the preferred work-group size multiple of the
+ * kernel, bounded by its maximum work-group size and by block_size_limit if
+ * it is not 0. The number of blocks resident on a compute unit is bounded by
+ * the local memory of the device, where each block uses the local memory of
+ * the kernel plus local_mem_of(block_size) bytes, and by the maximum
+ * work-group size of the device, which stands for the number of work-items a
+ * compute unit can hold since SYCL does not expose it.
+ * The kernel is taken from the registry if it was prebuilt there, and built
+ * otherwise.
+ */
+template <typename command_group_t, typename local_mem_fn_t>
+occupancy_t max_potential_block_size_variable_local_mem(
+    cl::sycl::queue& q, local_mem_fn_t local_mem_of, int block_size_limit = 0,
+    const kernel_registry* registry = nullptr) {
+  using kernel_t = typename command_group_t::kernel_type;
+  auto dev = q.get_device();
+  const cl::sycl::kernel* prebuilt =
+      registry ? registry->find_kernel<kernel_t>() : nullptr;
+  cl::sycl::program program(q.get_context());
+  if (!prebuilt) {
+    program.build_with_kernel_type<kernel_t>();
+  }
+  cl::sycl::kernel k = prebuilt ? *prebuilt : program.get_kernel<kernel_t>();
+
+  using wg_info = cl::sycl::info::kernel_work_group;
+  size_t kernel_max = k.get_work_group_info<wg_info::work_group_size>(dev);
+  size_t multiple = std::max<size_t>(
+      1, k.get_work_group_info<wg_info::preferred_work_group_size_multiple>(
+             dev));
+  size_t kernel_local = static_cast<size_t>(
+      k.get_work_group_info<wg_info::local_mem_size>(dev));
+  size_t device_local = static_cast<size_t>(
+      dev.get_info<cl::sycl::info::device::local_mem_size>());
+  size_t device_max =
+      dev.get_info<cl::sycl::info::device::max_work_group_size>();
+  size_t compute_units = static_cast<size_t>(
+      dev.get_info<cl::sycl::info::device::max_compute_units>());
+
+  size_t max_block = kernel_max;
+  if (block_size_limit > 0) {
+    max_block = std::min(max_block, static_cast<size_t>(block_size_limit));
+  }
+  // Devices whose preferred multiple exceeds the limit still get a block
+  size_t first = std::min(multiple, max_block);
+
+  occupancy_t best{0, 0};
+  size_t best_resident = 0;
+  for (size_t block = first; block <= max_block; block += multiple) {
+    size_t local = kernel_local + static_cast<size_t>(local_mem_of(
+                                      static_cast<int>(block))) +
+                   warp_scratch::get_size<typename kernel_t::type>(
+                       dim3(block, 1, 1));
+    if (local > device_local) {
+      // Larger blocks only need more local memory
+      break;
+    }
+    size_t blocks = device_max / block;
+    if (local > 0) {
+      blocks = std::min(blocks, device_local / local);
+    }
+    blocks = std::max<size_t>(blocks, 1);
+    size_t resident = blocks * block;
+    // Ties keep the larger block, which needs fewer work-groups
+    if (resident >= best_resident) {
+      best_resident = resident;
+      best.block_size = static_cast<int>(block);
+      best.min_grid_size = static_cast<int>(blocks * compute_units);
+    }
+  }
+  if (best.block_size == 0) {
+    throw std::invalid_argument(
+        "The kernel does not fit in the local memory of the device");
+  }
+  return best;
+}
+
+/**
+ * Equivalent of cudaOccupancyMaxPotentialBlockSize, where every block uses
+ * dynamic_local_mem bytes of dynamic local memory.
+ */
+template <typename command_group_t>
+occupancy_t max_potential_block_size(
+    cl::sycl::queue& q, size_t dynamic_local_mem = 0, int block_size_limit = 0,
+    const kernel_registry* registry = nullptr) {
+  return max_potential_block_size_variable_local_mem<command_group_t>(
+      q, [=](int) { return dynamic_local_mem; }, block_size_limit, registry);
+}
+
+/** graph_t.
+ * @brief Equivalent of a CUDA graph: records a sequence of copies, memsets and
+ * kernel launches once and replays it on a queue or a stream.
+ * The virtual pointers used by the nodes are resolved to their buffers when
+ * the node is added, so they must stay allocated while the graph is in use,
+ * and host pointers are read or written when the graph is replayed.
+ * Scalar kernel arguments can be updated between replays through the node
+ * returned by add_kernel.
+ */
+class graph_t {
+ public:
+  template <typename command_group_t>
+  class kernel_node {
+   public:
+    /**
+     * Replaces the I-th argument of the kernel for the following replays.
+     */
+    template <size_t I, typename T>
+    void set_param(T value) {
+      m_cg->template set_param<I>(value);
+    }
+
+   private:
+    friend class graph_t;
+    using resolved_t = typename command_group_t::resolved_type;
+    explicit kernel_node(resolved_t* cg) : m_cg(cg) {}
+    resolved_t* m_cg;
+  };
+
+  graph_t() : m_nodes{}, m_kernels{} {}
+
+  /**
+   * Records the launch of the given command group. The returned node refers
+   * to the graph and must not outlive it.
+   */
+  template <typename command_group_t>
+  kernel_node<command_group_t> add_kernel(const command_group_t& cg) {
+    using resolved_t = typename command_group_t::resolved_type;
+    auto state = new kernel_state<resolved_t>(cg.resolve());
+    m_kernels.emplace_back(state);
+    resolved_t* resolved = std::addressof(state->cg);
+    m_nodes.emplace_back(
+        [resolved](cl::sycl::handler& h) { resolved->operator()(h); });
+    return kernel_node<command_group_t>(resolved);
+  }
+
+  /**
+   * Records a copy of size bytes. Host to host copies cannot be recorded,
+   * and the source and destination of a device to device copy must belong
+   * to different allocations.
+   */
+  void add_memcpy(const void* src, void* dst, size_t size,
+                  Kind kind = Kind::Default) {
+    if (size == 0) {
+      return;
+    }
+    if (kind == Kind::Default) {
+      bool src_dev = is_device_pointer(src);
+      bool dst_dev = is_device_pointer(dst);
+      kind = src_dev ? (dst_dev ? Kind::DeviceToDevice : Kind::DeviceToHost)
+                     : (dst_dev ? Kind::HostToDevice : Kind::HostToHost);
+    }
+    switch (kind) {
+      case Kind::HostToDevice: {
+        auto dst_range = buffer_range(dst, size);
+        auto src_bytes = static_cast<const uint8_t*>(src);
+        m_nodes.emplace_back([=](cl::sycl::handler& h) mutable {
+          h.copy(src_bytes,
+                 dst_range.get_access<cl::sycl::access::mode::discard_write>(
+                     h));
+        });
+        break;
+      }
+      case Kind::DeviceToHost: {
+        auto src_range = buffer_range(src, size);
+        auto dst_bytes = static_cast<uint8_t*>(dst);
+        m_nodes.emplace_back([=](cl::sycl::handler& h) mutable {
+          h.copy(src_range.get_access<cl::sycl::access::mode::read>(h),
+                 dst_bytes);
+        });
+        break;
+      }
+      case Kind::DeviceToDevice: {
+        if (is_same_allocation(src, dst)) {
+          throw std::invalid_argument(
+              "Device to device copies within an allocation cannot be "
+              "recorded");
+        }
+        auto src_range = buffer_range(src, size);
+        auto dst_range = buffer_range(dst, size);
+        m_nodes.emplace_back([=](cl::sycl::handler& h) mutable {
+          h.copy(src_range.get_access<cl::sycl::access::mode::read>(h),
+                 dst_range.get_access<cl::sycl::access::mode::discard_write>(
+                     h));
+        });
+        break;
+      }
+      default:
+        throw std::invalid_argument("Host to host copies cannot be recorded");
+    }
+  }
+
+  /**
+   * Records a memset of size bytes of device memory.
+   */
+  void add_memset(void* dst, int value, size_t size) {
+    if (size == 0) {
+      return;
+    }
+    auto dst_range = buffer_range(dst, size);
+    // The cast to uint8_t is here to match the behaviour of the standard
+    // memset.
+    auto byte = static_cast<uint8_t>(value);
+    m_nodes.emplace_back([=](cl::sycl::handler& h) mutable {
+      h.fill(dst_range.get_access<cl::sycl::access::mode::discard_write>(h),
+             byte);
+    });
+  }
+
+  /**
+   * Submits every recorded node in order to the given queue or stream.
+   * @return The event of the last node
+   */
+  template <typename queue_t>
+  cl::sycl::event launch(queue_t& q) {
+    cl::sycl::event last{};
+    for (auto& node : m_nodes) {
+      last = q.submit(node);
+    }
+    return last;
   }
+
+  cl::sycl::event launch(cudaStream_t stream) { return launch(*stream); }
+
+  size_t get_num_nodes() const { return m_nodes.size(); }
+
+ private:
+  // The resolved command groups are never used as operands of overloadable
+  // operators or owned by smart pointers of their own type: the argument
+  // dependent lookup would instantiate the user functor with the resolved
+  // argument types, which it cannot be instantiated with
+  struct kernel_state_base {
+    virtual ~kernel_state_base() = default;
+  };
+
+  template <typename resolved_t>
+  struct kernel_state : kernel_state_base {
+    explicit kernel_state(const resolved_t& c) : cg(c) {}
+    resolved_t cg;
+  };
+
+  std::vector<std::function<void(cl::sycl::handler&)>> m_nodes;
+  std::vector<std::unique_ptr<kernel_state_base>> m_kernels;
 };
 
 // raw pointer class is used to extract the multi-pointer from accessor class
 template <typename type_t>
 struct raw_pointer {
   using type = type_t;
-  static inline type get_pointer(type_t dt) { return dt; }
+  static inline type get_pointer(const type_t& dt) { return dt; }
 };
 template <typename T1, typename T2>
 struct raw_pointer<real_accessor_t<T1, acc_t<T2>>> {
@@ -266,16 +2594,25 @@ struct raw_pointer<real_accessor_t<T1, acc_t<T2>>> {
       T1, cl::sycl::access::address_space::global_space>::pointer_t;
   using type =
       cl::sycl::multi_ptr<T1, cl::sycl::access::address_space::global_space>;
-  static inline type get_pointer(real_accessor_t<T1, acc_t<T2>> dt) {
+  static inline type get_pointer(const real_accessor_t<T1, acc_t<T2>>& dt) {
     return type(reinterpret_cast<T1*>(dt.acc_.get_pointer().get()));
   }
 };
 
+template <typename T>
+struct raw_pointer<constant_accessor_t<T>> {
+  using type =
+      cl::sycl::multi_ptr<T, cl::sycl::access::address_space::constant_space>;
+  static inline type get_pointer(const constant_accessor_t<T>& dt) {
+    return type(reinterpret_cast<T*>(dt.acc_.get_pointer().get()));
+  }
+};
+
 template <>
 struct raw_pointer<local_acc_t> {
   using type = typename cl::sycl::multi_ptr<
       uint8_t, cl::sycl::access::address_space::local_space>::pointer_t;
-  static inline type get_pointer(local_acc_t dt) {
+  static inline type get_pointer(const local_acc_t& dt) {
     return dt.get_pointer().get();
   }
 };
@@ -304,7 +2641,9 @@ class Generic_Kernel_Functor<u_k_t<blockIdx_t, threadIdx_t, blockDim_t,
   gridDim_t gridDim;
   nd_item_t it_;
   // N+1 elements. The first N elements are the parameters of the cuda kernel
-  // the last element is the local memory
+  // the last element is the local memory. When launched through
+  // CudaCommandGroup the elements are references to the parameters stored in
+  // the kernel dispatcher.
   utility::tuple::Tuple<Param_t...> t;
   Generic_Kernel_Functor(blockIdx_t blockIdx_, threadIdx_t threadIdx_,
                          blockDim_t blockDim_, gridDim_t gridDim_, nd_item_t it,
@@ -314,30 +2653,341 @@ class Generic_Kernel_Functor<u_k_t<blockIdx_t, threadIdx_t, blockDim_t,
         blockDim(blockDim_),
         gridDim(gridDim_),
         it_(it),
-        t(utility::tuple::make_tuple(param...)) {}
+        t(param...) {
+#if COMPATIBILITY_SYCL_2020
+    warpSize = static_cast<int>(it_.get_sub_group().get_local_range()[0]);
+#else
+    warpSize = COMPATIBILITY_WARP_SIZE;
+#endif
+  }
 
   void __syncthreads() {
     it_.barrier(cl::sycl::access::fence_space::global_and_local);
   }
 
+  // The dynamic local memory requested at launch starts after the warp
+  // scratch area
   template <typename T>
   T* get_local_mem() {
+    size_t scratch = warp_scratch::get_size<user_kernel_type>(blockDim);
     return cl::sycl::multi_ptr<T, cl::sycl::access::address_space::local_space>(
-        (reinterpret_cast<T*>(raw_pointer<local_acc_t>::get_pointer(
-            utility::tuple::get<sizeof...(Param_t) - 1>(t)))));
+        (reinterpret_cast<T*>(get_local_base() + scratch)));
   }
 
-  template <typename... removed_local_param_t, size_t... Is>
-  inline void unpack(utility::tuple::Tuple<removed_local_param_t...> t_removed,
-                     utility::tuple::IndexList<Is...>) {
-    call_func(*(reinterpret_cast<user_kernel_type*>(this)),
-              (raw_pointer<removed_local_param_t>::get_pointer(
-                  utility::tuple::get<Is>(t_removed)))...);
+  /**
+   * Returns an arena over the dynamic local memory, to allocate several
+   * typed arrays from it.
+   */
+  local_arena get_local_arena() {
+    size_t scratch = warp_scratch::get_size<user_kernel_type>(blockDim);
+    size_t size = utility::tuple::get<sizeof...(Param_t) - 1>(t).get_range()[0];
+    return local_arena(get_local_base() + scratch, size - scratch);
+  }
+
+  /* Warp-level intrinsics.
+   * On the SYCL 2020 path a warp is a sub-group, and warpSize is the size of
+   * the sub-group; sub-groups run along the last SYCL dimension, so kernels
+   * calling the intrinsics must be launched with one-dimensional blocks.
+   * Otherwise a warp is emulated as COMPATIBILITY_WARP_SIZE consecutive
+   * threads of the block, numbered as CUDA numbers them, exchanging values
+   * through local memory; in that case every work-item of the work-group must
+   * reach the intrinsic, since it contains work-group barriers, which the
+   * kernel states through uniform_warp_calls, and the values exchanged cannot
+   * be larger than 8 bytes. Lanes past the end of a partial last warp read
+   * their own value.
+   * The masks are assumed to cover every active lane of the warp, and ballots
+   * only represent the first 32 lanes.
+   */
+  int warpSize;
+
+  /* Index of the calling work-item inside its warp */
+  int get_lane_id() {
+#if COMPATIBILITY_SYCL_2020
+    return static_cast<int>(it_.get_sub_group().get_local_linear_id());
+#else
+    return static_cast<int>(cuda_linear_id() % warpSize);
+#endif
+  }
+
+  template <typename T>
+  T __shfl_sync(unsigned, T var, int srcLane, int width = 0) {
+    width = (width == 0) ? warpSize : width;
+    int lane = get_lane_id();
+    int src = (lane / width) * width + (srcLane % width);
+#if COMPATIBILITY_SYCL_2020
+    T res = cl::sycl::select_from_group(it_.get_sub_group(), var,
+                                        src < warpSize ? src : lane);
+    return src < warpSize ? res : var;
+#else
+    return warp_exchange(var, src);
+#endif
+  }
+
+  template <typename T>
+  T __shfl_down_sync(unsigned, T var, unsigned delta, int width = 0) {
+    width = (width == 0) ? warpSize : width;
+    int lane = get_lane_id();
+    bool in_range = (lane % width) + static_cast<int>(delta) < width;
+#if COMPATIBILITY_SYCL_2020
+    T res = cl::sycl::shift_group_left(it_.get_sub_group(), var, delta);
+#else
+    int src = in_range ? lane + static_cast<int>(delta) : lane;
+    T res = warp_exchange(var, src);
+#endif
+    return in_range ? res : var;
+  }
+
+  template <typename T>
+  T __shfl_up_sync(unsigned, T var, unsigned delta, int width = 0) {
+    width = (width == 0) ? warpSize : width;
+    int lane = get_lane_id();
+    bool in_range = (lane % width) >= static_cast<int>(delta);
+#if COMPATIBILITY_SYCL_2020
+    T res = cl::sycl::shift_group_right(it_.get_sub_group(), var, delta);
+#else
+    int src = in_range ? lane - static_cast<int>(delta) : lane;
+    T res = warp_exchange(var, src);
+#endif
+    return in_range ? res : var;
+  }
+
+  template <typename T>
+  T __shfl_xor_sync(unsigned, T var, int laneMask, int width = 0) {
+    width = (width == 0) ? warpSize : width;
+    int lane = get_lane_id();
+    int src = lane ^ laneMask;
+    bool in_range = (src / width) == (lane / width) && src < warpSize;
+#if COMPATIBILITY_SYCL_2020
+    T res = cl::sycl::select_from_group(it_.get_sub_group(), var,
+                                        in_range ? src : lane);
+#else
+    T res = warp_exchange(var, in_range ? src : lane);
+#endif
+    return in_range ? res : var;
+  }
+
+  unsigned __ballot_sync(unsigned, int predicate) {
+    int lane = get_lane_id();
+    unsigned bit = (predicate && lane < 32) ? (1u << lane) : 0u;
+    return warp_reduce(bit, warp_ops::bit_or<unsigned>());
+  }
+
+  int __any_sync(unsigned, int predicate) {
+    return warp_reduce(static_cast<int>(predicate != 0),
+                       warp_ops::bit_or<int>());
+  }
+
+  int __all_sync(unsigned, int predicate) {
+    return warp_reduce(static_cast<int>(predicate != 0),
+                       warp_ops::bit_and<int>());
+  }
+
+  /**
+   * Reduces the value across the warp with one of the operations of warp_ops
+   * and returns the result to every lane.
+   */
+  template <typename T, typename op_t>
+  T warp_reduce(T value, op_t op) {
+#if COMPATIBILITY_SYCL_2020
+    return cl::sycl::reduce_over_group(it_.get_sub_group(), value, op);
+#else
+    auto scratch = warp_scratch_ptr<T>();
+    size_t lid = cuda_linear_id();
+    size_t base = lid - get_lane_id();
+    size_t wg_size = blockDim.x * blockDim.y * blockDim.z;
+    size_t end = cl::sycl::min(base + warpSize, wg_size);
+    it_.barrier(cl::sycl::access::fence_space::local_space);
+    scratch[lid] = value;
+    it_.barrier(cl::sycl::access::fence_space::local_space);
+    T res = scratch[base];
+    for (size_t i = base + 1; i < end; i++) {
+      res = op(res, scratch[i]);
+    }
+    return res;
+#endif
+  }
+
+  template <typename T>
+  T __reduce_add_sync(unsigned, T value) {
+    return warp_reduce(value, warp_ops::plus<T>());
+  }
+
+  template <typename T>
+  T __reduce_min_sync(unsigned, T value) {
+    return warp_reduce(value, warp_ops::minimum<T>());
+  }
+
+  template <typename T>
+  T __reduce_max_sync(unsigned, T value) {
+    return warp_reduce(value, warp_ops::maximum<T>());
+  }
+
+  void __syncwarp(unsigned = 0xffffffff) {
+#if COMPATIBILITY_SYCL_2020
+    it_.get_sub_group().barrier();
+#else
+    check_uniform_warp_calls();
+    it_.barrier(cl::sycl::access::fence_space::local_space);
+#endif
   }
+
+  /* Atomic operations.
+   * The atomicXxx functions operate on global memory, as the kernel
+   * parameters do, and the atomicXxx_shared variants on the dynamic local
+   * memory returned by get_local_mem. The second argument is not deduced, so
+   * that literals are converted to the type of the address.
+   */
+  template <typename T>
+  T atomicAdd(T* address, typename std::common_type<T>::type val) {
+    return global_atomics::fetch_add(address, val);
+  }
+
+  template <typename T>
+  T atomicSub(T* address, typename std::common_type<T>::type val) {
+    return global_atomics::fetch_sub(address, val);
+  }
+
+  template <typename T>
+  T atomicMax(T* address, typename std::common_type<T>::type val) {
+    return global_atomics::fetch_max(address, val);
+  }
+
+  template <typename T>
+  T atomicMin(T* address, typename std::common_type<T>::type val) {
+    return global_atomics::fetch_min(address, val);
+  }
+
+  template <typename T>
+  T atomicExch(T* address, typename std::common_type<T>::type val) {
+    return global_atomics::exchange(address, val);
+  }
+
+  template <typename T>
+  T atomicCAS(T* address, typename std::common_type<T>::type compare,
+              typename std::common_type<T>::type val) {
+    return global_atomics::compare_exchange(address, compare, val);
+  }
+
+  template <typename T>
+  T atomicAdd_shared(T* address, typename std::common_type<T>::type val) {
+    return local_atomics::fetch_add(address, val);
+  }
+
+  template <typename T>
+  T atomicSub_shared(T* address, typename std::common_type<T>::type val) {
+    return local_atomics::fetch_sub(address, val);
+  }
+
+  template <typename T>
+  T atomicMax_shared(T* address, typename std::common_type<T>::type val) {
+    return local_atomics::fetch_max(address, val);
+  }
+
+  template <typename T>
+  T atomicMin_shared(T* address, typename std::common_type<T>::type val) {
+    return local_atomics::fetch_min(address, val);
+  }
+
+  template <typename T>
+  T atomicExch_shared(T* address, typename std::common_type<T>::type val) {
+    return local_atomics::exchange(address, val);
+  }
+
+  template <typename T>
+  T atomicCAS_shared(T* address, typename std::common_type<T>::type compare,
+                     typename std::common_type<T>::type val) {
+    return local_atomics::compare_exchange(address, compare, val);
+  }
+
+  /* Texture reads.
+   * tex2D and tex3D sample the texture at floating point coordinates, which
+   * are normalized or not as set in its texture_desc, and tex1Dfetch reads
+   * the i-th element of a texture created from linear memory.
+   */
+  template <typename T>
+  T tex1Dfetch(const texture_accessor_t<T, 2>& tex, int i) {
+    return tex.fetch(cl::sycl::int2(i % tex.width_, i / tex.width_));
+  }
+
+  template <typename T>
+  T tex2D(const texture_accessor_t<T, 2>& tex, float x, float y) {
+    return tex.sample(cl::sycl::float2(x, y));
+  }
+
+  template <typename T>
+  T tex3D(const texture_accessor_t<T, 3>& tex, float x, float y, float z) {
+    return tex.sample(cl::sycl::float4(x, y, z, 0.0f));
+  }
+
+ private:
+  using global_atomics =
+      atomic_ops<cl::sycl::access::address_space::global_space>;
+  using local_atomics =
+      atomic_ops<cl::sycl::access::address_space::local_space>;
+
+  typename raw_pointer<local_acc_t>::type get_local_base() {
+    return raw_pointer<local_acc_t>::get_pointer(
+        utility::tuple::get<sizeof...(Param_t) - 1>(t));
+  }
+
+#if !COMPATIBILITY_SYCL_2020
+  template <typename T>
+  T* warp_scratch_ptr() {
+    static_assert(uses_warp_scratch<user_kernel_type>::value,
+                  "Kernels calling warp intrinsics must declare "
+                  "uses_warp_intrinsics");
+    static_assert(sizeof(T) <= warp_scratch::bytes_per_item,
+                  "Warp operations are limited to 8 byte values");
+    check_uniform_warp_calls();
+    return cl::sycl::multi_ptr<T, cl::sycl::access::address_space::local_space>(
+        reinterpret_cast<T*>(get_local_base()));
+  }
+
+  static void check_uniform_warp_calls() {
+    static_assert(has_uniform_warp_calls<user_kernel_type>::value,
+                  "Without sub-groups warp intrinsics use work-group "
+                  "barriers, so every work-item of the block must call them. "
+                  "Declare uniform_warp_calls if the kernel does, or "
+                  "restructure divergent calls such as if (tid < 32)");
+  }
+
+  // Linear index of the work-item in its block as CUDA numbers threads, with
+  // threadIdx.x varying fastest. SYCL linearizes the local id with dimension
+  // 0, which holds threadIdx.x, varying slowest, so the emulated warps are
+  // built from this index to hold the same threads as CUDA warps.
+  size_t cuda_linear_id() const {
+    return static_cast<size_t>(threadIdx.x) +
+           static_cast<size_t>(threadIdx.y) * blockDim.x +
+           static_cast<size_t>(threadIdx.z) * blockDim.x * blockDim.y;
+  }
+
+  // Every lane publishes var and reads the value of the lane src of its warp,
+  // or its own value when src is past the last work-item of a partial warp
+  template <typename T>
+  T warp_exchange(T var, int src) {
+    auto scratch = warp_scratch_ptr<T>();
+    size_t lid = cuda_linear_id();
+    size_t base = lid - get_lane_id();
+    size_t wg_size = it_.get_local_range().size();
+    it_.barrier(cl::sycl::access::fence_space::local_space);
+    scratch[lid] = var;
+    it_.barrier(cl::sycl::access::fence_space::local_space);
+    return (base + src < wg_size) ? scratch[base + src] : var;
+  }
+#endif
+
+ public:
+  // Value type of the I-th kernel parameter
+  template <size_t I>
+  using param_value_t = typename std::decay<typename utility::tuple::
+                                                ElemTypeHolder<I, decltype(t)>::
+                                                    type>::type;
+
   template <size_t... Is>
-  inline void wrapper(utility::tuple::IndexList<Is...> indices) {
-    unpack(utility::tuple::make_tuple((utility::tuple::get<Is>(t))...),
-           indices);
+  inline void wrapper(utility::tuple::IndexList<Is...>) {
+    call_func(*(reinterpret_cast<user_kernel_type*>(this)),
+              (raw_pointer<param_value_t<Is>>::get_pointer(
+                  utility::tuple::get<Is>(t)))...);
   }
 };
 
@@ -0,0 +1,135 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2018 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  launch_benchmark.cpp
+ *
+ *  Description:
+ *   Compares the time taken by a converted kernel launched as a 3D and as a
+ *   1D CudaCommandGroup with the same kernel written directly in SYCL.
+ *
+ **************************************************************************/
+#include <chrono>
+#include <iostream>
+
+// Header added by the source to source tool
+#include "compatibility_definitions.hpp"
+
+// Generated class:: Kernel dispatch.
+// This signature must be variadic
+template <typename... Args>
+struct ___CudaConverterFunctor___saxpy
+    : public cl::sycl::codeplay::Generic_Kernel_Functor<
+          ___CudaConverterFunctor___saxpy<Args...>> {
+  using parent = cl::sycl::codeplay::Generic_Kernel_Functor<
+      ___CudaConverterFunctor___saxpy<Args...>>;
+  using parent::__syncthreads;
+  using parent::blockDim;
+  using parent::blockIdx;
+  using parent::gridDim;
+  using parent::threadIdx;
+
+  ___CudaConverterFunctor___saxpy(Args... args) : parent(args...) {}
+  // kernel executor
+  template <typename... params_t>
+  void __execute__(params_t... params) {
+    saxpy(params...);
+  }
+  __global__ void saxpy(int n, float a, float* x, float* y) {
+    int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) y[i] = a * x[i] + y[i];
+  }
+};
+
+class handwritten_saxpy;
+
+// Submits the given launch `iterations` times and returns the average time
+// per launch in microseconds
+template <typename launch_t>
+double time_launches(cl::sycl::queue& q, int iterations, launch_t launch) {
+  // Warm-up launch, which also builds the kernel
+  launch();
+  q.wait();
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    launch();
+  }
+  q.wait();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+int main(int argc, char* argv[]) {
+  const int n = 1 << 22;
+  const int iterations = 100;
+  const int blockSize = 256;
+  const int numBlocks = (n + blockSize - 1) / blockSize;
+  const float a = 2.0f;
+  size_t bytes = n * sizeof(float);
+
+  cl::sycl::queue deviceQueue((cl::sycl::default_selector()));
+  auto& pMap = cl::sycl::codeplay::get_global_pointer_mapper();
+
+  float* d_x = static_cast<float*>(cl::sycl::codeplay::SYCLmalloc(bytes, pMap));
+  float* d_y = static_cast<float*>(cl::sycl::codeplay::SYCLmalloc(bytes, pMap));
+  cl::sycl::codeplay::sycl_memset(deviceQueue, d_x, 0, bytes);
+  cl::sycl::codeplay::sycl_memset(deviceQueue, d_y, 0, bytes);
+
+  using saxpy_t = ___CudaConverterFunctor___saxpy<int, float, float*, float*>;
+
+  auto t3d = time_launches(deviceQueue, iterations, [&]() {
+    deviceQueue.submit(cl::sycl::codeplay::CudaCommandGroup<saxpy_t>(
+        numBlocks, blockSize, n, a, d_x, d_y));
+  });
+
+  auto t1d = time_launches(deviceQueue, iterations, [&]() {
+    deviceQueue.submit(cl::sycl::codeplay::CudaCommandGroup<saxpy_t, 1>(
+        numBlocks, blockSize, n, a, d_x, d_y));
+  });
+
+  auto tsycl = time_launches(deviceQueue, iterations, [&]() {
+    deviceQueue.submit([&](cl::sycl::handler& h) {
+      auto x = pMap.get_access<cl::sycl::access::mode::read>(d_x, h);
+      auto y = pMap.get_access<cl::sycl::access::mode::read_write>(d_y, h);
+      h.parallel_for<handwritten_saxpy>(
+          cl::sycl::nd_range<1>(cl::sycl::range<1>(numBlocks * blockSize),
+                                cl::sycl::range<1>(blockSize)),
+          [=](cl::sycl::nd_item<1> it) {
+            int i = it.get_global_id(0);
+            // Keep the constness and the address space of the accessors
+            auto px = reinterpret_cast<
+                cl::sycl::global_ptr<const float>::pointer_t>(
+                x.get_pointer().get());
+            auto py = reinterpret_cast<cl::sycl::global_ptr<float>::pointer_t>(
+                y.get_pointer().get());
+            if (i < n) py[i] = a * px[i] + py[i];
+          });
+    });
+  });
+
+  std::cout << "CudaCommandGroup 3D: " << t3d << " us/launch\n";
+  std::cout << "CudaCommandGroup 1D: " << t1d << " us/launch\n";
+  std::cout << "Handwritten SYCL:    " << tsycl << " us/launch\n";
+
+  SYCLfree(d_x, pMap);
+  SYCLfree(d_y, pMap);
+
+  return 0;
+}
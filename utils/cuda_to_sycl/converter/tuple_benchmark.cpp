@@ -0,0 +1,227 @@
+/***************************************************************************
+ *
+ *  Copyright (C) 2018 Codeplay Software Limited
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  For your convenience, a copy of the License has been included in this
+ *  repository.
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  Codeplay's ComputeCpp SDK
+ *
+ *  tuple_benchmark.cpp
+ *
+ *  Description:
+ *   Compile-time benchmark of the tuple used to hold the kernel arguments.
+ *   For TUPLE_KERNELS argument lists of TUPLE_ELEMENTS distinct types it
+ *   does what a command group does: builds the tuple, appends the local
+ *   memory, removes it again and reads every element. Compiling with
+ *   RECURSIVE_TUPLE defined uses the previous head/tail design instead of
+ *   STLTuple.hpp. The tuple_compile_benchmark make target times both.
+ *
+ **************************************************************************/
+#include <cstddef>
+#include <type_traits>
+
+#ifndef TUPLE_ELEMENTS
+#define TUPLE_ELEMENTS 32
+#endif
+
+#ifndef TUPLE_KERNELS
+#define TUPLE_KERNELS 32
+#endif
+
+#ifdef RECURSIVE_TUPLE
+
+// The previous design, in which the tuple nests its tail and every lookup
+// recurses on the index.
+namespace recursive {
+
+template <bool, typename T = void>
+struct StaticIf;
+template <typename T>
+struct StaticIf<true, T> {
+  typedef T type;
+};
+
+template <class... Ts>
+struct Tuple {};
+
+template <class T, class... Ts>
+struct Tuple<T, Ts...> {
+  Tuple(T t, Ts... ts) : head(t), tail(ts...) {}
+  T head;
+  Tuple<Ts...> tail;
+};
+
+template <typename, typename>
+struct concat_tuple {};
+
+template <typename... Ts, typename... Us>
+struct concat_tuple<Tuple<Ts...>, Tuple<Us...>> {
+  using type = Tuple<Ts..., Us...>;
+};
+
+template <typename T>
+struct remove_last_type;
+
+template <typename T>
+struct remove_last_type<Tuple<T>> {
+  using type = Tuple<>;
+};
+
+template <typename T, typename... Args>
+struct remove_last_type<Tuple<T, Args...>> {
+  using type = typename concat_tuple<
+      Tuple<T>, typename remove_last_type<Tuple<Args...>>::type>::type;
+};
+
+template <size_t, class>
+struct ElemTypeHolder;
+
+template <class T, class... Ts>
+struct ElemTypeHolder<0, Tuple<T, Ts...>> {
+  typedef T type;
+};
+
+template <size_t k, class T, class... Ts>
+struct ElemTypeHolder<k, Tuple<T, Ts...>> {
+  typedef typename ElemTypeHolder<k - 1, Tuple<Ts...>>::type type;
+};
+
+template <size_t k, class... Ts>
+typename StaticIf<k == 0,
+                  typename ElemTypeHolder<0, Tuple<Ts...>>::type&>::type
+get(Tuple<Ts...>& t) {
+  return t.head;
+}
+
+template <size_t k, class T, class... Ts>
+typename StaticIf<k != 0,
+                  typename ElemTypeHolder<k, Tuple<T, Ts...>>::type&>::type
+get(Tuple<T, Ts...>& t) {
+  return recursive::get<k - 1>(t.tail);
+}
+
+template <typename... Args>
+Tuple<Args...> make_tuple(Args... args) {
+  return Tuple<Args...>(args...);
+}
+
+template <size_t... Is>
+struct IndexList {};
+
+template <size_t MIN, size_t N, size_t... Is>
+struct RangeBuilder;
+
+template <size_t MIN, size_t... Is>
+struct RangeBuilder<MIN, MIN, Is...> {
+  typedef IndexList<Is...> type;
+};
+
+template <size_t MIN, size_t N, size_t... Is>
+struct RangeBuilder : public RangeBuilder<MIN, N - 1, N - 1, Is...> {};
+
+template <size_t MIN, size_t MAX>
+struct IndexRange : RangeBuilder<MIN, MAX>::type {};
+
+template <typename... Args, typename T, size_t... I>
+Tuple<Args..., T> append_base(Tuple<Args...> t, T a, IndexList<I...>) {
+  return recursive::make_tuple(get<I>(t)..., a);
+}
+
+template <typename... Args, typename T>
+Tuple<Args..., T> append(Tuple<Args...> t, T a) {
+  return recursive::append_base(t, a, IndexRange<0, sizeof...(Args)>());
+}
+
+}  // namespace recursive
+
+namespace tuple_impl = recursive;
+
+#else
+
+#include "stl-tuple/STLTuple.hpp"
+
+namespace tuple_impl = utility::tuple;
+
+#endif
+
+// The index lists of the benchmark itself are built the same way for both
+// designs, so only the tuple operations differ.
+template <size_t... Is>
+struct indices {};
+
+template <class, class>
+struct join_indices;
+
+template <size_t... Is, size_t... Js>
+struct join_indices<indices<Is...>, indices<Js...>> {
+  typedef indices<Is..., (sizeof...(Is) + Js)...> type;
+};
+
+template <size_t N>
+struct make_indices {
+  typedef typename join_indices<typename make_indices<N / 2>::type,
+                                typename make_indices<N - N / 2>::type>::type
+      type;
+};
+
+template <>
+struct make_indices<0> {
+  typedef indices<> type;
+};
+
+template <>
+struct make_indices<1> {
+  typedef indices<0> type;
+};
+
+// Argument I of kernel K, so that every kernel has its own tuple types
+template <size_t K, size_t I>
+struct arg {
+  int value;
+};
+
+struct local_memory {
+  int size;
+};
+
+template <size_t K, size_t... Is>
+int kernel(indices<Is...>) {
+  auto t = tuple_impl::make_tuple(arg<K, Is>{static_cast<int>(Is)}...);
+  auto t2 = tuple_impl::append(t, local_memory{0});
+  using params_t =
+      typename tuple_impl::remove_last_type<decltype(t2)>::type;
+  static_assert(std::is_same<params_t, decltype(t)>::value,
+                "remove_last_type must undo append");
+  int sum = tuple_impl::get<sizeof...(Is)>(t2).size;
+  int unused[] = {(sum += tuple_impl::get<Is>(t2).value, 0)...};
+  (void)unused;
+  return sum;
+}
+
+template <size_t... Ks>
+int run(indices<Ks...>) {
+  int sum = 0;
+  int unused[] = {
+      (sum += kernel<Ks>(typename make_indices<TUPLE_ELEMENTS>::type()),
+       0)...};
+  (void)unused;
+  return sum;
+}
+
+int main() {
+  const int expected =
+      TUPLE_KERNELS * (TUPLE_ELEMENTS * (TUPLE_ELEMENTS - 1) / 2);
+  return run(make_indices<TUPLE_KERNELS>::type()) == expected ? 0 : 1;
+}